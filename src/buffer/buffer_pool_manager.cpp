@@ -53,12 +53,14 @@ namespace sjtu {
    * @param num_frames The size of the buffer pool.
    * @param disk_manager_ The disk manager.
    * @param k_dist The backward k-distance for the LRU-K replacer.
+   * @param read_only Open an existing file for inspection, nothing is ever written back.
    */
-  BufferPoolManager::BufferPoolManager(size_t num_frames,std::string db_file,size_t k_dist)
+  BufferPoolManager::BufferPoolManager(size_t num_frames,std::string db_file,size_t k_dist,
+                                       bool read_only)
     : num_frames_(num_frames),
       next_page_id_(0),
       replacer_(std::make_shared<LRUKReplacer>(num_frames, k_dist)) {
-    disk_manager_ = std::make_shared<DiskManager>(db_file);
+    disk_manager_ = std::make_shared<DiskManager>(db_file, read_only);
     // Not strictly necessary...
     // std::scoped_lock latch(*bpm_latch_);
 
@@ -440,7 +442,7 @@ namespace sjtu {
   }
 
   /**
-   * @brief Flushes all page data that is in memory to disk.
+   * @brief Flushes all dirty page data that is in memory to disk.
    *
    * ### Implementation
    *
@@ -450,7 +452,9 @@ namespace sjtu {
   void BufferPoolManager::FlushAllPages() {
     // bpm_latch_->lock();
     for (auto it: page_table_) {
-      FlushPage(it.first);
+      if (frames_[it.second]->is_dirty_) {
+        FlushPage(it.first);
+      }
     }
     // bpm_latch_->unlock();
   }
@@ -17,7 +17,15 @@ static char *buffer_used;
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
  */
-DiskManager::DiskManager(const std::filesystem::path &db_file) : file_name_(db_file) {
+DiskManager::DiskManager(const std::filesystem::path &db_file, bool read_only)
+    : file_name_(db_file), read_only_(read_only) {
+  if (read_only_) {
+    db_io_.open(db_file, std::ios::binary | std::ios::in);
+    if (!db_io_.is_open()) {
+      throw std::runtime_error("can't open db file");
+    }
+    return;
+  }
   db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
   // directory or file does not exist
   if (!db_io_.is_open()) {
@@ -58,7 +66,7 @@ DiskManager::DiskManager(const std::filesystem::path &db_file) : file_name_(db_f
   void DiskManager::IncreaseDiskSpace(size_t pages) {
     // std::scoped_lock scoped_db_io_latch(db_io_latch_);
 
-    if (pages < pages_) {
+    if (pages < pages_ || read_only_) {
       return;
     }
 
@@ -77,6 +85,9 @@ DiskManager::DiskManager(const std::filesystem::path &db_file) : file_name_(db_f
    */
   void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
     // std::scoped_lock scoped_db_io_latch(db_io_latch_);
+    if (read_only_) {
+      return;
+    }
     size_t offset = static_cast<size_t>(page_id) * SJTU_PAGE_SIZE;
 
     // Set the write cursor to the page offset.
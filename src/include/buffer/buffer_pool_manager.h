@@ -96,7 +96,8 @@ namespace sjtu {
    */
   class BufferPoolManager {
   public:
-    BufferPoolManager(size_t num_frames,std::string db_file, size_t k_dist = LRUK_REPLACER_K);
+    BufferPoolManager(size_t num_frames,std::string db_file, size_t k_dist = LRUK_REPLACER_K,
+                      bool read_only = false);
 
     ~BufferPoolManager();
 
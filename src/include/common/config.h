@@ -7,16 +7,40 @@
 namespace sjtu {
   static constexpr int INVALID_FRAME_ID = -1; // invalid frame id
   static constexpr int INVALID_PAGE_ID = -1; // invalid page id
+  static constexpr uint32_t INVALID_STATION_ID = UINT32_MAX; // invalid station id
+  static constexpr uint32_t INVALID_TRAIN_ID = UINT32_MAX; // invalid train id
 
   static constexpr int SJTU_PAGE_SIZE = 5120; // size of a data page in byte
   static constexpr int BUFFER_POOL_SIZE = 500; // size of buffer pool
   static constexpr int DEFAULT_DB_IO_SIZE = 16; // starting size of file on disk
   static constexpr int LRUK_REPLACER_K = 10; // backward k-distance for lru-k
+  static constexpr int BULK_FILL_PERCENT = 75; // page fill left by batch inserts
+  static constexpr int APPEND_SPLIT_PERCENT = 90; // load kept by a leaf split by an append
+  static constexpr int LAZY_MERGE_PERCENT = 20; // underflow watermark of lazy b+ trees
+  static constexpr int BLOOM_BITS_PER_KEY = 10; // bloom filter size, about 1% false positives
+  static constexpr int BLOOM_MIN_CAPACITY = 1024; // keys a fresh bloom filter is sized for
+  static constexpr int PINNED_LEVEL_CNT = 2; // upper b+ tree levels kept pinned
+  static constexpr int PINNED_PAGE_CNT = 64; // pinned pages per b+ tree, at most a quarter of its pool
+  static constexpr int HTABLE_HEADER_MAX_DEPTH = 9; // directory slots of a hash table header page
+  static constexpr int HTABLE_DIRECTORY_MAX_DEPTH = 9; // bucket slots of a hash table directory page
+  static constexpr int HTABLE_HEADER_DEPTH = 4; // default header depth of a new hash table
+  static constexpr int LSM_MEMTABLE_SIZE = 2048; // entries an lsm tree buffers before a flush
+  static constexpr int LSM_L0_RUN_LIMIT = 4; // flushed runs before they merge into level 1
+  static constexpr int LSM_LEVEL_RATIO = 8; // size ratio of adjacent lsm levels
+  static constexpr int LSM_MAX_LEVELS = 8; // levels of an lsm tree, the last one grows unbounded
+  static constexpr int LSM_RUN_POOL_SIZE = 8; // buffer pool frames per lsm run
 
   using frame_id_t = int32_t; // frame id type
   using page_id_t = int32_t; // page id type
   using hash_t = size_t;
   using num_t = int32_t;
+  using station_t = uint32_t; // dense station id, see StationDict
+  using train_t = uint32_t; // dense train id, see TrainCatalog
 
-  using DateRange = std::pair<num_t, num_t>;
+  // first and last date, a plain struct so that records holding it stay
+  // trivially copyable
+  struct DateRange {
+    num_t first;
+    num_t second;
+  };
 } // namespace sjtu
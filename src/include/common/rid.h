@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+#include "common/config.h"
+
+namespace sjtu {
+  /**
+   * Record id: the heap page a record lives in and its slot within that page.
+   */
+  class RID {
+  public:
+    RID() = default;
+
+    RID(page_id_t page_id, uint32_t slot_num) : page_id_(page_id), slot_num_(slot_num) {}
+
+    auto GetPageId() const -> page_id_t { return page_id_; }
+
+    auto GetSlotNum() const -> uint32_t { return slot_num_; }
+
+    auto operator==(const RID &other) const -> bool {
+      return page_id_ == other.page_id_ && slot_num_ == other.slot_num_;
+    }
+
+  private:
+    page_id_t page_id_{INVALID_PAGE_ID};
+    uint32_t slot_num_{0};
+  };
+} // namespace sjtu
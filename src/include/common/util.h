@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <cstring>
+#include <type_traits>
+#include <utility>
 #include "common/config.h"
 #include "common/vector.h"
 #include <iostream>
@@ -25,6 +28,30 @@ inline auto ToHash(const char str[]) -> hash_t {
   return hash;
 }
 
+// Scrambles all bits of hash into all others (the murmur3 finalizer), since
+// the hashes from ToHash are weak in their low bits.
+inline auto MixHash(uint64_t hash) -> uint64_t {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// Well mixed hash of an index key. Keys are hashes or pairs of integral
+// members, so the members are folded in one by one.
+template <typename KeyType>
+inline auto KeyHash(const KeyType &key) -> uint64_t {
+  static_assert(std::is_integral_v<KeyType>, "no hash for this key type");
+  return MixHash(static_cast<uint64_t>(key));
+}
+
+template <typename First, typename Second>
+inline auto KeyHash(const std::pair<First, Second> &key) -> uint64_t {
+  return MixHash(KeyHash(key.first) * 31 + KeyHash(key.second));
+}
+
 inline void ParseCommand(std::string &command,
                          sjtu::vector<std::string> *parsed_command) {
   std::istringstream iss(command);
@@ -35,50 +62,73 @@ inline void ParseCommand(std::string &command,
   }
 }
 
-struct HashComp {
-  int operator()(const hash_t lhs, const hash_t rhs) const {
-    if (lhs != rhs) {
-      if (lhs < rhs) {
-        return -1;
-      }
-      return 1;
+/**
+ * Order-preserving encoding of index keys into one unsigned integer, the
+ * big-endian byte string of the key read as a number. Integral members are
+ * laid out most significant first at their full width, signed ones with the
+ * sign bit flipped, so comparing two encodings compares the keys member by
+ * member, and comparing the upper bits only compares a prefix of members.
+ */
+using norm_key_t = unsigned __int128;
+
+template <typename KeyType>
+struct KeyTraits {
+  static_assert(std::is_integral_v<KeyType>, "no normalized form for this key type");
+  static constexpr int BITS = sizeof(KeyType) * 8;
+
+  static constexpr auto Encode(KeyType key) -> norm_key_t {
+    using Bits = std::make_unsigned_t<KeyType>;
+    auto bits = static_cast<Bits>(key);
+    if constexpr (std::is_signed_v<KeyType>) {
+      bits ^= static_cast<Bits>(Bits{1} << (BITS - 1));
     }
-    return 0;
+    return bits;
   }
 };
 
-template <typename T>
-struct PairCompare {
-  int operator()(const T &lhs, const T &rhs) {
-    if (lhs.first < rhs.first) {
-      return -1;
-    }
-    if (lhs.first > rhs.first) {
-      return 1;
-    }
-    if (lhs.second < rhs.second) {
-      return -1;
-    }
-    if (lhs.second > rhs.second) {
-      return 1;
-    }
-    return 0;
+template <typename First, typename Second>
+struct KeyTraits<std::pair<First, Second> > {
+  static constexpr int BITS = KeyTraits<First>::BITS + KeyTraits<Second>::BITS;
+  static_assert(BITS <= 128, "key too wide to normalize");
+
+  static constexpr auto Encode(const std::pair<First, Second> &key) -> norm_key_t {
+    return (KeyTraits<First>::Encode(key.first) << KeyTraits<Second>::BITS) |
+           KeyTraits<Second>::Encode(key.second);
   }
 };
 
-template <typename T>
-struct PairDegradedCompare {
-  int operator()(const T &lhs, const T &rhs) {
-    if (lhs.first < rhs.first) {
-      return -1;
-    }
-    if (lhs.first > rhs.first) {
-      return 1;
-    }
-    return 0;
+/**
+ * Three-way comparison of the first PrefixBits bits of the normalized keys,
+ * a single wide integer compare. The comparators of the indexes derive from
+ * it, which also lets the page search work on normalized keys directly.
+ */
+template <typename KeyType, int PrefixBits = KeyTraits<KeyType>::BITS>
+struct NormalizedCompare {
+  using NormalizedKey = KeyType;
+  static constexpr int SHIFT = KeyTraits<KeyType>::BITS - PrefixBits;
+
+  static constexpr auto Prefix(const KeyType &key) -> norm_key_t {
+    return KeyTraits<KeyType>::Encode(key) >> SHIFT;
+  }
+
+  int operator()(const KeyType &lhs, const KeyType &rhs) const {
+    auto lhs_prefix = Prefix(lhs);
+    auto rhs_prefix = Prefix(rhs);
+    return static_cast<int>(lhs_prefix > rhs_prefix) - static_cast<int>(lhs_prefix < rhs_prefix);
   }
 };
 
+struct HashComp : NormalizedCompare<hash_t> {};
+
+// Orders pairs by both members.
+template <typename T>
+struct PairCompare : NormalizedCompare<T> {};
+
+// Orders pairs by their first member only, for prefix lookups.
+template <typename T>
+struct PairDegradedCompare
+    : NormalizedCompare<T, KeyTraits<typename T::first_type>::BITS> {};
+
 inline std::string ToDate(num_t date) {
   const char *month = (date <= 30) ? "06" : (date <= 61) ? "07" : (date <= 92) ? "08" : "09";
   int day = (date <= 30) ? date : (date <= 61) ? date - 30 : (date <= 92) ? date - 61 : date - 92;
@@ -127,7 +177,7 @@ struct DateTime {
     }
   };
 
-  friend std::ostream &operator<<(std::ostream &os, DateTime &date_time) {
+  friend std::ostream &operator<<(std::ostream &os, const DateTime &date_time) {
     std::cout << ToDate(date_time.date) << ' ' << ToTime(date_time.time);
     return os;
   }
@@ -149,7 +199,7 @@ struct DateTime {
     }
   }
 
-  num_t operator-(DateTime &rhs) {
+  num_t operator-(const DateTime &rhs) const {
     return (date - rhs.date) * 1440 + (time - rhs.time);
   }
 
@@ -176,15 +226,6 @@ struct DateTime {
   }
 };
 
-inline void InsertStations(char station[][31], std::string &s) {
-  std::istringstream iss(s);
-  std::string str;
-  int cnt = 0;
-  while (getline(iss, str, '|')) {
-    strncpy(station[cnt++], str.c_str(), 30);
-  }
-}
-
 inline void InsertNum(num_t time[], std::string &t) {
   if(t[0]=='_') {
     return;
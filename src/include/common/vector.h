@@ -3,6 +3,7 @@
 #include <climits>
 #include <cstddef>
 #include <cstdlib>
+#include <stdexcept>
 #include <utility>
 
 namespace sjtu {
@@ -17,11 +18,13 @@ namespace sjtu {
     size_t capacity_ = 0;
 
     void double_capacity() {
-      T *tmp = (T *) malloc(2 * capacity_ * sizeof(T));
+      // an empty vector may not have allocated yet
+      size_t new_capacity = capacity_ == 0 ? 1 : 2 * capacity_;
+      T *tmp = (T *) malloc(new_capacity * sizeof(T));
       for (int i = 0; i < size_; ++i) {
         new(tmp + i) T(std::move(arr_[i]));
       }
-      capacity_ *= 2;
+      capacity_ = new_capacity;
       if (arr_ != nullptr) {
         for (int i = 0; i < size_; ++i) {
           arr_[i].~T();
@@ -525,7 +528,9 @@ namespace sjtu {
       for (int i = size_ - 1; i >= length; --i) {
         new(arr_ + i + 1)T(std::move(arr_[i]));
       }
-      arr_[length].~T();
+      if (length < size_) {
+        arr_[length].~T();
+      }
       new(arr_ + length)T(value);
       size_++;
       return iterator(&arr_[length], this);
@@ -547,7 +552,9 @@ namespace sjtu {
       for (int i = size_ - 1; i >= ind; --i) {
         new(arr_ + i + 1)T(std::move(arr_[i]));
       }
-      arr_[ind].~T();
+      if (ind < size_) {
+        arr_[ind].~T();
+      }
       new(arr_ + ind)T(value);
       size_++;
       return iterator(&arr_[ind], this);
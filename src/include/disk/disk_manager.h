@@ -19,8 +19,10 @@ namespace sjtu {
     /**
      * Creates a new disk manager that writes to the specified database file.
      * @param db_file the file name of the database file to write to
+     * @param read_only open an existing file without ever resizing or writing
+     * it, page writes are dropped
      */
-    explicit DiskManager(const std::filesystem::path &db_file);
+    explicit DiskManager(const std::filesystem::path &db_file, bool read_only = false);
 
     /** FOR TEST / LEADERBOARD ONLY, used by DiskManagerMemory */
     DiskManager() = default;
@@ -95,6 +97,7 @@ namespace sjtu {
     // stream to write db file
     std::fstream db_io_;
     std::filesystem::path file_name_;
+    bool read_only_{false};
     int num_flushes_{0};
     int num_writes_{0};
     int num_deletes_{0};
@@ -17,6 +17,8 @@ class Management {
 
  private:
   User *user_;
+  StationDict *stations_;
+  TrainCatalog *catalog_;
   Ticket *ticket_;
   Train *train_;
 };
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/config.h"
+#include "common/util.h"
+#include "storage/extendible_hash_table.h"
+
+namespace sjtu {
+// longest station name in bytes, the terminator not included
+static constexpr int STATION_NAME_SIZE = 30;
+
+struct StationDictHeaderPage {
+  page_id_t next_page_id_;
+  station_t station_cnt_;
+};
+
+// names of consecutive station ids
+struct StationNamePage {
+  static constexpr int SLOT_CNT = SJTU_PAGE_SIZE / (STATION_NAME_SIZE + 1);
+
+  char names_[SLOT_CNT][STATION_NAME_SIZE + 1];
+};
+
+/**
+ * Persistent dictionary of station names. Every name gets a dense id the
+ * first time it is interned, records and index keys carry the id, and the
+ * name is only looked up again for printing.
+ *
+ * Names are found through their ToHash, like users and trains. The name of
+ * id lives in slot id % SLOT_CNT of name page 2 + id / SLOT_CNT, so it is
+ * read without any search.
+ */
+class StationDict {
+ public:
+  explicit StationDict(const std::string &name);
+
+  ~StationDict();
+
+  // id of name, assigning the next free one if name is new
+  auto Intern(const std::string &name) -> station_t;
+
+  // id of name, INVALID_STATION_ID if it was never interned
+  auto Find(std::string &name) -> station_t;
+
+  auto Name(station_t id) -> std::string;
+
+ private:
+  std::unique_ptr<ExtendibleHashTable<hash_t, station_t, HashComp> > id_db_;
+
+  std::unique_ptr<BufferPoolManager> name_manager_;
+
+  page_id_t header_page_id_;
+
+  station_t station_cnt_;
+};
+}  // namespace sjtu
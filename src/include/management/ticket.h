@@ -2,65 +2,36 @@
 
 #include "common/config.h"
 #include "common/util.h"
+#include "management/station.h"
+#include "management/train_catalog.h"
 #include "storage/b_plus_tree.h"
+#include "storage/heap_b_plus_tree.h"
+#include "storage/selectable_index.h"
 #include "user.h"
 
 namespace sjtu {
 class Train;
-using TrainDate = std::pair<hash_t, num_t>;  // trainID_hash && date
-using OrderTime = std::pair<hash_t, int>;    // username_hash && timestamp
-using TrainDateOrder = std::pair<std::pair<hash_t, num_t>, int>;
-using TrainDate = std::pair<hash_t, num_t>;
-using StationTrain = std::pair<hash_t, hash_t>;
+using TrainDate = std::pair<train_t, num_t>;  // train id && date
+using OrderTime = std::pair<hash_t, int>;     // username_hash && timestamp
+using TrainDateOrder = std::pair<TrainDate, int>;
+using StationTrain = std::pair<station_t, train_t>;  // station id && train id
 
 enum class TicketStatus { Success, Pending, Refunded };
 
-struct TDOCompare {
-  int operator()(const TrainDateOrder &lhs, const TrainDateOrder &rhs) const {
-    if (lhs.first.first != rhs.first.first) {
-      if (lhs.first.first < rhs.first.first) {
-        return -1;
-      }
-      return 1;
-    }
-    if (lhs.first.second != rhs.first.second) {
-      if (lhs.first.second < rhs.first.second) {
-        return -1;
-      }
-      return 1;
-    }
-    if (lhs.second < rhs.second) {
-      return -1;
-    } else if (lhs.second > rhs.second) {
-      return 1;
-    }
-    return 0;
-  }
-};
+// Orders (train, date, order) keys by all three members.
+struct TDOCompare : NormalizedCompare<TrainDateOrder> {};
 
-struct TDODegradedCompare {
-  int operator()(const TrainDateOrder &lhs, const TrainDateOrder &rhs) const {
-    if (lhs.first.first != rhs.first.first) {
-      if (lhs.first.first < rhs.first.first) {
-        return -1;
-      }
-      return 1;
-    }
-    if (lhs.first.second != rhs.first.second) {
-      if (lhs.first.second < rhs.first.second) {
-        return -1;
-      }
-      return 1;
-    }
-    return 0;
-  }
-};
+// Orders (train, date, order) keys by train and date only.
+struct TDODegradedCompare
+    : NormalizedCompare<TrainDateOrder, KeyTraits<TrainDate>::BITS> {};
 
 struct TicketDateInfo {
   num_t seatMaxNum = 0;
+  num_t segmentNum = 0;
   int seatNum[99] = {};
 
-  TicketDateInfo(int seatnum, num_t stationnum) : seatMaxNum(seatnum) {
+  TicketDateInfo(int seatnum, num_t stationnum)
+      : seatMaxNum(seatnum), segmentNum(stationnum - 1) {
     for (int i = 0; i < stationnum - 1; ++i) {
       seatNum[i] = seatnum;
     }
@@ -81,12 +52,41 @@ struct TicketDateInfo {
   }
 };  // 200bytes,changed when release
 
+// Only the seats of the train's segments are stored, so a record's length
+// is fixed once the train is released and seat updates stay in place.
+template <>
+struct RecordCodec<TicketDateInfo> {
+  static constexpr bool VARIABLE_LENGTH = true;
+  static constexpr int MIN_SIZE = 2 * sizeof(num_t);
+  static constexpr int MAX_SIZE = MIN_SIZE + 99 * sizeof(int);
+
+  static auto Size(const TicketDateInfo &info) -> int {
+    return MIN_SIZE + info.segmentNum * static_cast<int>(sizeof(int));
+  }
+
+  static void Encode(const TicketDateInfo &info, char *dst) {
+    RecordWriter writer(dst);
+    writer.Put(info.seatMaxNum);
+    writer.Put(info.segmentNum);
+    memcpy(dst + MIN_SIZE, info.seatNum, info.segmentNum * sizeof(int));
+  }
+
+  static auto Decode(const char *src) -> TicketDateInfo {
+    TicketDateInfo info(0, 1);
+    RecordReader reader(src);
+    reader.Get(&info.seatMaxNum);
+    reader.Get(&info.segmentNum);
+    memcpy(info.seatNum, src + MIN_SIZE, info.segmentNum * sizeof(int));
+    return info;
+  }
+};
+
 struct OrderInfo {
   int timestamp;
   TicketStatus status;
-  char trainID[21]{};
-  char from[31]{};
-  char to[31]{};
+  train_t train;
+  station_t from;
+  station_t to;
   num_t from_index;
   num_t to_index;
   DateTime leavingTime;
@@ -95,38 +95,36 @@ struct OrderInfo {
   int num;
   num_t init_date;
 
-  OrderInfo(int stamp, TicketStatus s, const char ID[], const char f[],
-            const char t[], num_t index_1, num_t index_2, DateTime &l_time,
-            DateTime &a_time, int p, int n, num_t init_d)
+  OrderInfo(int stamp, TicketStatus s, train_t tr, station_t f, station_t t,
+            num_t index_1, num_t index_2, DateTime &l_time, DateTime &a_time,
+            int p, int n, num_t init_d)
       : timestamp(stamp),
         status(s),
+        train(tr),
+        from(f),
+        to(t),
         leavingTime(l_time),
         arrivingTime(a_time),
         price(p),
         num(n),
         from_index(index_1),
         to_index(index_2),
-        init_date(init_d) {
-    strncpy(trainID, ID, 20);
-    strncpy(from, f, 30);
-    strncpy(to, t, 30);
-  }
-};  // 100bytes, static info besides status
+        init_date(init_d) {}
+};  // 56bytes, static info besides status
 
 struct PendingInfo {
   int timestamp;
   hash_t username_hash;
-  hash_t trainID_hash;
+  train_t train;
   num_t from_index;
   num_t to_index;
   int num;
   num_t init_date;
-};  // 48 bytes
+};  // 32 bytes
 // searched by train_ID,should check avaibility then change OrderInfo::status
 
+// The train is the second half of the key.
 struct StationTrainInfo {
-  hash_t trainID_hash;
-  char trainID[21]{};
   num_t station_index;
   int price;
   DateRange saleDate;
@@ -135,37 +133,14 @@ struct StationTrainInfo {
 
   StationTrainInfo() = delete;
 
-  StationTrainInfo(hash_t hash, const char ID[], num_t index, int price,
-                   DateRange date, DateTime a_time, DateTime l_time)
-      : trainID_hash(hash),
-        station_index(index),
+  StationTrainInfo(num_t index, int price, DateRange date, DateTime a_time,
+                   DateTime l_time)
+      : station_index(index),
         price(price),
         saleDate(date),
         arrivingTime(a_time),
-        leavingTime(l_time) {
-    strncpy(trainID, ID, 20);
-  }
-
-  StationTrainInfo(const StationTrainInfo &other)
-      : arrivingTime(other.arrivingTime), leavingTime(other.leavingTime) {
-    trainID_hash = other.trainID_hash;
-    strncpy(trainID, other.trainID, 20);
-    station_index = other.station_index;
-    price = other.price;
-    saleDate = other.saleDate;
-  }
-
-  StationTrainInfo &operator=(const StationTrainInfo &other) {
-    trainID_hash = other.trainID_hash;
-    strncpy(trainID, other.trainID, 20);
-    station_index = other.station_index;
-    price = other.price;
-    saleDate = other.saleDate;
-    arrivingTime = other.arrivingTime;
-    leavingTime = other.leavingTime;
-    return *this;
-  }
-};  // 48 bytes ,changed when release
+        leavingTime(l_time) {}
+};  // 32 bytes ,changed when release
 
 struct TicketComp {
   num_t time;
@@ -175,11 +150,12 @@ struct TicketComp {
   num_t station_index_2;
   DateTime leavingTime;
   DateTime arrivingTime;
-  hash_t trainID_hash;
+  train_t train;
+  // only kept to break ties in the ranking
   char trainID[21]{};
 
   TicketComp(num_t time, int cost, int t_num, num_t index_1, num_t index_2,
-             DateTime l_time, DateTime a_time, hash_t hash, char ID[])
+             DateTime l_time, DateTime a_time, train_t tr, const char ID[])
       : time(time),
         cost(cost),
         ticket_num(t_num),
@@ -187,7 +163,7 @@ struct TicketComp {
         station_index_2(index_2),
         leavingTime(l_time),
         arrivingTime(a_time),
-        trainID_hash(hash) {
+        train(tr) {
     strncpy(trainID, ID, 20);
   }
 };  // 56bytes
@@ -195,15 +171,17 @@ struct TicketComp {
 struct TicketTransComp {
   num_t time;
   int cost;
-  char station[31]{};
+  station_t station;
   TicketComp ticket_1;
   TicketComp ticket_2;
+  // start dates of the two trains, the keys of their seats in ticket_db_
+  num_t init_date_1 = 0;
+  num_t init_date_2 = 0;
 
-  TicketTransComp(TicketComp &ticket_1, TicketComp &ticket_2, const char st[])
-      : ticket_1(ticket_1), ticket_2(ticket_2) {
+  TicketTransComp(TicketComp &ticket_1, TicketComp &ticket_2, station_t st)
+      : station(st), ticket_1(ticket_1), ticket_2(ticket_2) {
     time = ticket_2.arrivingTime - ticket_1.leavingTime;
     cost = ticket_1.cost + ticket_2.cost;
-    strncpy(station, st, 30);
   }
 };
 
@@ -267,7 +245,11 @@ class Ticket {
   friend Train;
 
  public:
-  Ticket(std::string &name, User *user);
+  // pending_engine picks the engine of the pending queue, which is written
+  // by every queued buy_ticket and read only by refunds
+  Ticket(std::string &name, User *user, StationDict *stations,
+         TrainCatalog *catalog,
+         IndexEngine pending_engine = IndexEngine::BPlusTree);
 
   void QueryTicket(std::string &from, std::string &to, num_t date,
                    std::string comp = "time");
@@ -283,10 +265,18 @@ class Ticket {
 
   void RefundTicket(std::string &username, int n = 1);
 
+  // print the Stats of every index, one line each
+  void Inspect();
+
+  // rewrite every index with its leaves in key order, see BPlusTree::Compact
+  void Compact();
+
  private:
-  // the date of train start
-  std::unique_ptr<BPlusTree<TrainDate, TicketDateInfo, PairCompare<TrainDate>,
-                            PairDegradedCompare<TrainDate> > >
+  // the date of train start; seats are rewritten on every purchase, so the
+  // records sit in a heap file and the index only holds their ids
+  std::unique_ptr<HeapBPlusTree<TrainDate, TicketDateInfo,
+                                PairCompare<TrainDate>,
+                                PairDegradedCompare<TrainDate> > >
       ticket_db_;
 
   std::unique_ptr<BPlusTree<OrderTime, OrderInfo, PairCompare<OrderTime>,
@@ -294,8 +284,8 @@ class Ticket {
       order_db_;
 
   // also should be the date train start
-  std::unique_ptr<
-      BPlusTree<TrainDateOrder, PendingInfo, TDOCompare, TDODegradedCompare> >
+  std::unique_ptr<SelectableIndex<TrainDateOrder, PendingInfo, TDOCompare,
+                                  TDODegradedCompare> >
       pending_db_;
 
   std::unique_ptr<
@@ -304,5 +294,9 @@ class Ticket {
       station_db_;
 
   User *user_;
+
+  StationDict *stations_;
+
+  TrainCatalog *catalog_;
 };
 }  // namespace sjtu
\ No newline at end of file
@@ -11,60 +11,63 @@ namespace sjtu {
 class Ticket;
 
 struct TrainInfo {
-  hash_t train_id_hash;
   num_t stationNum;
   int seatNum;
   num_t startTime;
-  num_t travelTimes[99]{};
-  num_t stopoverTimes[98]{};
-  int prices[99]{};
+  // Timetable of station i, in minutes after the train leaves its first
+  // station and in the price of the ride from there. The first station is
+  // reached when the train leaves it and the last one is left on arrival,
+  // so any leg is two lookups.
+  num_t arrivingOffsets[100]{};
+  num_t leavingOffsets[100]{};
+  int prices[100]{};
   DateRange saleDate;
   char type;
   char trainID[21]{};
-  char stations[100][31]{};
+  // ids in StationDict, filled in by Train::AddTrain
+  station_t stations[100]{};
 
-  TrainInfo(std::string &i, std::string &n, std::string &m, std::string &s,
-            std::string &p, std::string &x, std::string &t, std::string &o,
-            std::string &d, std::string &y) {
-    train_id_hash = ToHash(i);
+  TrainInfo(std::string &i, std::string &n, std::string &m, std::string &p,
+            std::string &x, std::string &t, std::string &o, std::string &d,
+            std::string &y) {
     strncpy(trainID, i.c_str(), 20);
     stationNum = static_cast<num_t>(std::stoi(n));
     seatNum = std::stoi(m);
     startTime = TimeToNum(x);
     type = y[0];
-    InsertStations(stations, s);
-    InsertNum(travelTimes, t);
-    InsertNum(stopoverTimes, o);
-    InsertNum(prices, p);
+    num_t travel_times[99]{};
+    num_t stopover_times[98]{};
+    int segment_prices[99]{};
+    InsertNum(travel_times, t);
+    InsertNum(stopover_times, o);
+    InsertNum(segment_prices, p);
+    for (int k = 1; k < stationNum; ++k) {
+      arrivingOffsets[k] = leavingOffsets[k - 1] + travel_times[k - 1];
+      leavingOffsets[k] = arrivingOffsets[k];
+      if (k != stationNum - 1) {
+        leavingOffsets[k] += stopover_times[k - 1];
+      }
+      prices[k] = prices[k - 1] + segment_prices[k - 1];
+    }
     saleDate = DateRange{DateToNum(d.substr(0, 5)), DateToNum(d.substr(6, 5))};
   }
 
   TrainInfo &operator=(const TrainInfo &other) {
-    train_id_hash = other.train_id_hash;
     stationNum = other.stationNum;
     seatNum = other.seatNum;
     startTime = other.startTime;
     type = other.type;
     saleDate = other.saleDate;
-    for (int i = 0; i < stationNum; ++i) {
-      strncpy(stations[i], other.stations[i], 30);
-    }
+    memcpy(stations, other.stations, stationNum * sizeof(station_t));
     strncpy(trainID, other.trainID, 20);
-    memcpy(prices, other.prices, (stationNum - 1) * sizeof(int));
-    memcpy(travelTimes, other.travelTimes, (stationNum - 1) * sizeof(num_t));
-    memcpy(stopoverTimes, other.stopoverTimes,
-           (stationNum - 2) * sizeof(num_t));
+    memcpy(prices, other.prices, stationNum * sizeof(int));
+    memcpy(arrivingOffsets, other.arrivingOffsets, stationNum * sizeof(num_t));
+    memcpy(leavingOffsets, other.leavingOffsets, stationNum * sizeof(num_t));
     return *this;
   }
-};  // 3832 bytes, stored as single page
+};  // 1644 bytes, stored as single page
 // Static info only
 
-struct TrainMeta {
-  page_id_t page_id;
-  DateRange saleDate;
-  bool is_released = false;
-};
-
 class Train {
   friend Ticket;
 
@@ -73,7 +76,8 @@ class Train {
 
   ~Train();
 
-  void AddTrain(TrainInfo &train);
+  // stations are the '|' separated station names of train
+  void AddTrain(TrainInfo &train, std::string &stations);
 
   void DeleteTrain(std::string &trainID);
 
@@ -84,8 +88,6 @@ class Train {
  private:
   std::unique_ptr<BufferPoolManager> train_manager_;
 
-  std::unique_ptr<BPlusTree<hash_t, TrainMeta, HashComp, HashComp> > train_db_;
-
   Ticket *ticket_;
 
   page_id_t header_page_id_;
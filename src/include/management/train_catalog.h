@@ -0,0 +1,72 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/config.h"
+#include "common/util.h"
+#include "storage/extendible_hash_table.h"
+
+namespace sjtu {
+struct TrainMeta {
+  page_id_t page_id;
+  DateRange saleDate;
+  bool is_released = false;
+  char trainID[21]{};
+};  // 36 bytes
+
+struct TrainCatalogHeaderPage {
+  page_id_t next_page_id_;
+  train_t train_cnt_;
+};
+
+// metas of consecutive train ids
+struct TrainCatalogPage {
+  static constexpr int SLOT_CNT = SJTU_PAGE_SIZE / sizeof(TrainMeta);
+
+  TrainMeta metas_[SLOT_CNT];
+};
+
+/**
+ * Persistent catalog of trains. Every train gets a dense id when it is
+ * added, and records and index keys carry the id instead of a copy of the
+ * trainID or its hash.
+ *
+ * Only add_train and the commands naming a train look a trainID up, through
+ * its ToHash. The meta of id lives in slot id % SLOT_CNT of catalog page
+ * 2 + id / SLOT_CNT, so it is read without any search.
+ */
+class TrainCatalog {
+ public:
+  explicit TrainCatalog(const std::string &name);
+
+  ~TrainCatalog();
+
+  // id of trainID, INVALID_TRAIN_ID if no such train is listed
+  auto Find(std::string &trainID) -> train_t;
+
+  // list a new train under the next free id
+  auto Add(const TrainMeta &meta) -> train_t;
+
+  // unlist a train, its id is never handed out again
+  void Remove(train_t id);
+
+  auto Meta(train_t id) -> TrainMeta;
+
+  auto Name(train_t id) -> std::string;
+
+  void SetReleased(train_t id);
+
+ private:
+  auto MetaPageId(train_t id) const -> page_id_t;
+
+  std::unique_ptr<ExtendibleHashTable<hash_t, train_t, HashComp> > id_db_;
+
+  std::unique_ptr<BufferPoolManager> catalog_manager_;
+
+  page_id_t header_page_id_;
+
+  train_t train_cnt_;
+};
+}  // namespace sjtu
@@ -3,7 +3,8 @@
 #include <string.h>
 
 #include "common/util.h"
-#include "storage/b_plus_tree.h"
+#include "storage/extendible_hash_table.h"
+#include "storage/record_codec.h"
 
 namespace sjtu {
 class Ticket;
@@ -16,6 +17,8 @@ struct UserInfo {
   char mailaddr[31] = {};
   num_t privilege = 0;
 
+  UserInfo() = default;
+
   UserInfo(std::string &u, std::string &p, std::string &n, std::string &m,
            std::string &g) {
     username_hash = ToHash(u);
@@ -27,6 +30,43 @@ struct UserInfo {
   }
 };  // 100 bytes
 
+// The strings are stored with their actual lengths.
+template <>
+struct RecordCodec<UserInfo> {
+  static constexpr bool VARIABLE_LENGTH = true;
+  static constexpr int MIN_SIZE = sizeof(hash_t) + sizeof(num_t) + 4;
+  static constexpr int MAX_SIZE = MIN_SIZE + 20 + 30 + 15 + 30;
+
+  static auto Size(const UserInfo &user) -> int {
+    return MIN_SIZE - 4 + RecordWriter::StringSize(user.username, 20) +
+           RecordWriter::StringSize(user.password, 30) +
+           RecordWriter::StringSize(user.name, 15) +
+           RecordWriter::StringSize(user.mailaddr, 30);
+  }
+
+  static void Encode(const UserInfo &user, char *dst) {
+    RecordWriter writer(dst);
+    writer.Put(user.username_hash);
+    writer.Put(user.privilege);
+    writer.PutString(user.username, 20);
+    writer.PutString(user.password, 30);
+    writer.PutString(user.name, 15);
+    writer.PutString(user.mailaddr, 30);
+  }
+
+  static auto Decode(const char *src) -> UserInfo {
+    UserInfo user;
+    RecordReader reader(src);
+    reader.Get(&user.username_hash);
+    reader.Get(&user.privilege);
+    reader.GetString(user.username);
+    reader.GetString(user.password);
+    reader.GetString(user.name);
+    reader.GetString(user.mailaddr);
+    return user;
+  }
+};
+
 struct UserInfoOptional {
   hash_t username_hash = 0;
   char username[21] = {};
@@ -73,7 +113,8 @@ class User {
   auto IsLogged(std::string &username) const -> bool;
 
  private:
-  std::unique_ptr<BPlusTree<hash_t, UserInfo, HashComp, HashComp> > user_db_;
+  // users are only looked up by name
+  std::unique_ptr<ExtendibleHashTable<hash_t, UserInfo, HashComp> > user_db_;
 
   sjtu::map<hash_t, UserInfo> logged_user_;
 };
@@ -11,6 +11,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cstring>
 #include <filesystem>
 #include <iostream>
 #include <optional>
@@ -18,9 +19,11 @@
 #include <string>
 
 #include "common/config.h"
+#include "common/map.h"
 #include "storage/b_plus_tree_header_page.h"
 #include "storage/b_plus_tree_internal_page.h"
 #include "storage/b_plus_tree_leaf_page.h"
+#include "storage/index_iterator.h"
 #include "storage/page_guard.h"
 #include "common/vector.h"
 #include "common/util.h"
@@ -36,16 +39,15 @@ namespace sjtu {
    */
   class Context {
   public:
-    // When you insert into / remove from the B+ tree, store the write guard of header page here.
-    // Remember to drop the header page guard and set it to nullopt when you want to unlock all.
-    std::optional<WritePageGuard> header_page_{std::nullopt};
-
     // Save the root page id here so that it's easier to know if the current page is the root page.
     page_id_t root_page_id_{INVALID_PAGE_ID};
 
     // Store the write guards of the pages that you're modifying here.
     sjtu::vector<WritePageGuard> write_set_;
 
+    // Child slot taken in each internal page of write_set_ on the way down.
+    sjtu::vector<int> slot_set_;
+
     // You may want to use this when getting value, but not necessary.
     sjtu::vector<ReadPageGuard> read_set_;
 
@@ -54,6 +56,46 @@ namespace sjtu {
 
 #define BPLUSTREE_TYPE BPlusTree<KeyType, ValueType, KeyComparator,DegradedKeyComparator>
 
+  /**
+   * When Remove rebalances a node that lost an entry.
+   *
+   * Eager - borrow or merge as soon as the node drops below its minimum size.
+   * Lazy  - only once the node drops below LAZY_MERGE_PERCENT of its capacity
+   *         (or is empty), so trees with remove/insert churn do not cycle
+   *         through merges and splits around the minimum size.
+   */
+  enum class UnderflowPolicy { Eager, Lazy };
+
+  /**
+   * Shape and health of a B+ tree, collected by BPlusTree::Stats in one walk
+   * over every page reachable from the root.
+   */
+  struct BPlusTreeStats {
+    int height_{0};
+    // Pages and their average fill (load / capacity) per level, root first.
+    sjtu::vector<int> level_pages_;
+    sjtu::vector<double> level_fill_;
+    long long entry_cnt_{0};
+    // Leaves reached through the next pointers, starting at the leftmost.
+    int leaf_chain_length_{0};
+    // Pages allocated in the index file, and those the tree does not reach
+    // (freed by merges, or left behind by a resized Bloom filter).
+    int page_cnt_{0};
+    int orphan_page_cnt_{0};
+    // Keys out of order within a page, or outside the range their parent
+    // routes to the page.
+    int order_violation_cnt_{0};
+    // Bad page sizes, leaves at different depths, broken leaf links and
+    // subtree counts that do not match.
+    int structure_violation_cnt_{0};
+
+    auto IsHealthy() const -> bool {
+      return order_violation_cnt_ == 0 && structure_violation_cnt_ == 0;
+    }
+
+    void Print(std::ostream &os, const std::string &name) const;
+  };
+
   // Main class providing the API for the Interactive B+ Tree.
   INDEX_TEMPLATE_ARGUMENTS
   class BPlusTree {
@@ -61,33 +103,288 @@ namespace sjtu {
     using LeafPage = BPlusTreeLeafPage<KeyType, ValueType, KeyComparator, DegradedKeyComparator>;
 
   public:
+    using Iterator = INDEXITERATOR_TYPE;
+
+    // Default page capacities for this key / value combination. Internal
+    // pages hold page ids rather than values, so their capacity only depends
+    // on the key.
+    static constexpr int LEAF_MAX_SIZE = LeafPage::SLOT_CNT;
+    static constexpr int INTERNAL_MAX_SIZE = InternalPage::SLOT_CNT;
+
+    /**
+     * @param counted keep subtree entry counts in internal pages, which makes
+     * CountPrefix and SelectNthInPrefix logarithmic; only honored when the
+     * index file is created
+     * @param read_only open an existing index file for inspection, nothing is
+     * written back to it
+     */
     explicit BPlusTree(std::string name,
                        const KeyComparator &comparator, const DegradedKeyComparator &degraded_comparator,
                        int bpm_max_size = BUFFER_POOL_SIZE,
-                       int leaf_max_size = LEAF_PAGE_SLOT_CNT,
-                       int internal_max_size = INTERNAL_PAGE_SLOT_CNT);
+                       int leaf_max_size = LEAF_MAX_SIZE,
+                       int internal_max_size = INTERNAL_MAX_SIZE,
+                       bool counted = false, bool read_only = false);
 
     ~BPlusTree();
 
+    // Choose when Remove rebalances, Eager by default.
+    void SetUnderflowPolicy(UnderflowPolicy policy);
+
+    /**
+     * @brief Keep a Bloom filter of the keys, so GetValue, Update and Remove
+     * return without descending for most keys that are not in the tree
+     *
+     * The filter is saved into the index file on shutdown and loaded back
+     * here. It is rebuilt from the leaves instead if the last run did not
+     * shut down cleanly, if it was saved with another bits_per_key or if it
+     * got crowded by inserts or removes.
+     */
+    void EnableBloomFilter(int bits_per_key = BLOOM_BITS_PER_KEY);
+
     // Returns true if this B+ tree has no keys and values.
     auto IsEmpty() const -> bool;
 
     // Insert a key-value pair into this B+ tree.
     auto Insert(const KeyType &key, const ValueType &value) -> bool;
 
+    // Insert a key-value pair, overwriting the value if the key exists.
+    auto Upsert(const KeyType &key, const ValueType &value) -> bool;
+
+    // Apply mutator to the value associated with key in place.
+    template <typename Mutator>
+    auto Update(const KeyType &key, Mutator &&mutator) -> bool;
+
+    // Insert key-value pairs sorted by key, splitting each leaf at most once.
+    auto InsertBatch(const sjtu::vector<KeyType> &keys,
+                     const sjtu::vector<ValueType> &values) -> int;
+
+    // Build an empty B+ tree bottom-up from key-value pairs sorted by key.
+    auto BulkLoad(const sjtu::vector<KeyType> &keys,
+                  const sjtu::vector<ValueType> &values) -> bool;
+
+    /**
+     * Rewrite the tree into a fresh index file: leaves in key order on
+     * consecutive pages, every page filled to about fill_percent (at least
+     * half), so that scans read the file sequentially. The pages left behind
+     * by merges are dropped with the old file.
+     */
+    void Compact(int fill_percent = BULK_FILL_PERCENT);
+
     // Remove a key and its value from this B+ tree.
     void Remove(const KeyType &key);
 
+    /**
+     * Remove every entry whose key lies within [lo, hi]. Subtrees entirely
+     * inside the range are released without visiting their entries, and the
+     * leaf chain and the internal pages along the two ends of the range are
+     * fixed up once.
+     *
+     * @return number of entries removed
+     */
+    auto RemoveRange(const KeyType &lo, const KeyType &hi) -> int;
+
+    // Remove every entry matching prefix under the degraded comparator.
+    auto RemovePrefix(const KeyType &prefix) -> int;
+
     // Return the value associated with a given key
     auto GetValue(const KeyType &key, sjtu::vector<ValueType> *result) -> bool;
 
+    /**
+     * Look up many keys at once, result[i] receives the value of keys[i] if
+     * it exists. The keys may come in any order, they are sorted and the
+     * tree is walked once, reading each page they lead to a single time.
+     *
+     * @return number of keys found
+     */
+    auto MultiGet(const sjtu::vector<KeyType> &keys,
+                  sjtu::vector<std::optional<ValueType> > *result) -> int;
+
     // Return all the value associated with a given key
     auto GetAllValue(const KeyType &key, sjtu::vector<ValueType> *result) -> bool;
 
+    // Return a cursor at the first entry whose key is not less than key
+    auto LowerBound(const KeyType &key) -> Iterator;
+
+    // Visit the entries matching prefix in key order until visitor returns false
+    template <typename Visitor>
+    auto Scan(const KeyType &prefix, Visitor &&visitor) -> int;
+
+    // Return a cursor at the last entry matching prefix, for newest-first scans
+    auto SeekLast(const KeyType &prefix) -> Iterator;
+
+    // Visit the entries matching prefix in reverse key order until visitor
+    // returns false
+    template <typename Visitor>
+    auto ScanReverse(const KeyType &prefix, Visitor &&visitor) -> int;
+
+    /**
+     * Freeze the tree as it is now for ScanSnapshot. A page the tree changes
+     * later is copied right before its first change, and the snapshot reads
+     * the copy in its place, so it sees neither later inserts nor removes.
+     * Compact is skipped while any snapshot is open.
+     *
+     * @return id to pass to ScanSnapshot and ReleaseSnapshot
+     */
+    auto OpenSnapshot() -> int;
+
+    // Drop a snapshot, freeing the copies no other open snapshot reads.
+    void ReleaseSnapshot(int snapshot_id);
+
+    // Scan the tree as it was when snapshot_id was opened. The visitor may
+    // modify the tree.
+    template <typename Visitor>
+    auto ScanSnapshot(int snapshot_id, const KeyType &prefix, Visitor &&visitor)
+      -> int;
+
+    // Return the number of entries matching prefix
+    auto CountPrefix(const KeyType &prefix) -> int;
+
+    // Return a cursor at the n-th (0-based) entry matching prefix
+    auto SelectNthInPrefix(const KeyType &prefix, int n) -> Iterator;
+
     // Return the page id of the root node
     auto GetRootPageId() -> page_id_t;
 
+    // Walk the whole tree and collect its shape and any inconsistencies
+    auto Stats() -> BPlusTreeStats;
+
+    // Return true if Stats finds no order or structure violation
+    auto Verify() -> bool;
+
   private:
+    /**
+     * The leaf the last descending insert ended in, the separator keys that
+     * bound it and the internal slots leading to it. Keys growing within a
+     * prefix keep landing in the same leaf, InsertImpl then skips the
+     * descent. Any change of the tree structure clears it.
+     */
+    struct InsertHint {
+      page_id_t leaf_page_id_{INVALID_PAGE_ID};
+      std::optional<KeyType> lower_;
+      std::optional<KeyType> upper_;
+      sjtu::vector<page_id_t> path_;
+      sjtu::vector<int> slots_;
+
+      void Clear() { leaf_page_id_ = INVALID_PAGE_ID; }
+    };
+
+    /**
+     * A version of the tree frozen by OpenSnapshot. Pages allocated after it
+     * was opened are not part of it, the others are read from their copy if
+     * the tree has changed them since.
+     */
+    struct Snapshot {
+      int id_{0};
+      page_id_t root_page_id_{INVALID_PAGE_ID};
+      page_id_t page_limit_{INVALID_PAGE_ID};
+      // page id -> page holding its content as of the opening
+      sjtu::map<page_id_t, page_id_t> copies_;
+    };
+
+    auto FindSnapshot(int snapshot_id) const -> Snapshot *;
+
+    // Read page_id as snapshot sees it.
+    auto ReadSnapshotPage(const Snapshot &snapshot, page_id_t page_id)
+      -> ReadPageGuard;
+
+    // Copy page_id for the open snapshots that still read the live page.
+    void PreservePage(page_id_t page_id);
+
+    // Write a page of the tree, preserving it for open snapshots first.
+    auto WriteNode(page_id_t page_id) -> WritePageGuard;
+
+    // The leaves a range removal starts and ends in, and their depth.
+    struct RangeRemoval {
+      page_id_t first_leaf_{INVALID_PAGE_ID};
+      page_id_t last_leaf_{INVALID_PAGE_ID};
+      int leaf_depth_{0};
+    };
+
+    template <typename Comparator>
+    auto RemoveRangeImpl(const KeyType &lo, const KeyType &hi,
+                         const Comparator &comparator) -> int;
+
+    template <typename Comparator>
+    auto RemoveRangeSubtree(page_id_t page_id, int depth, const KeyType &lo,
+                            const KeyType &hi, const Comparator &comparator,
+                            RangeRemoval *removal) -> int;
+
+    // Release the subtree of page_id, levels above the leaves, which holds
+    // count entries if the tree is counted.
+    auto ReleaseSubtree(page_id_t page_id, int levels, int count) -> int;
+
+    template <typename Comparator>
+    auto FixRangeBoundary(page_id_t page_id, const KeyType &lo,
+                          const KeyType &hi, const Comparator &comparator) -> bool;
+
+    // Merge children left_pos and left_pos + 1 of parent if either underflows
+    // and they fit into one page, false if nothing changed.
+    auto RebalanceChildren(InternalPage *parent, int left_pos) -> bool;
+
+    // Insert through hint_, false if the descent cannot be skipped.
+    auto InsertAtHint(const KeyType &key, const ValueType &value) -> bool;
+
+    auto InsertImpl(const KeyType &key, const ValueType &value, bool overwrite)
+      -> bool;
+
+    void InsertIntoParent(Context &ctx, page_id_t remain_page_id,
+                          int remain_count, KeyType key_to_insert,
+                          page_id_t page_id_to_insert, int new_count);
+
+    void RelinkPrevPage(page_id_t page_id, page_id_t prev_page_id);
+
+    void AddToPathCounts(Context &ctx, int delta);
+
+    auto UnderflowSize(const BPlusTreePage *page) const -> int;
+
+    auto LeafUnderflowLoad(const LeafPage *leaf) const -> int;
+
+    auto LeafCapacity() const -> int;
+
+    auto BuildInternalLevels(sjtu::vector<KeyType> *level_keys,
+                             sjtu::vector<page_id_t> *level_pages,
+                             sjtu::vector<int> *level_counts,
+                             int fill_percent = BULK_FILL_PERCENT) -> page_id_t;
+
+    template <typename EntryCost>
+    auto LeafSplitPoint(int entry_cnt, EntryCost &&entry_cost, int target,
+                        int capacity) const -> int;
+
+    auto CountBefore(const KeyType &prefix, bool inclusive) -> int;
+
+    auto FindLeafPage(const KeyType &key) -> std::optional<ReadPageGuard>;
+
+    // False only if the Bloom filter rules key out.
+    auto MayContain(const KeyType &key) const -> bool;
+
+    void AddToBloomFilter(const KeyType &key);
+
+    void RebuildBloomFilter();
+
+    auto FindLastLeafPage(const KeyType &prefix)
+      -> std::optional<ReadPageGuard>;
+
+    void SetRootPageId(page_id_t root_page_id);
+
+    auto ReadNode(page_id_t page_id, int depth, ReadPageGuard *guard)
+      -> const BPlusTreePage *;
+
+    void ReleasePage(page_id_t page_id);
+
+    // Sort the indexes in order by their keys.
+    void SortProbes(const sjtu::vector<KeyType> &keys, sjtu::vector<int> *order) const;
+
+    auto MultiGetSubtree(page_id_t page_id, int depth,
+                         const sjtu::vector<KeyType> &keys,
+                         const sjtu::vector<int> &order, int begin, int end,
+                         sjtu::vector<std::optional<ValueType> > *result) -> int;
+
+    auto InspectSubtree(page_id_t page_id, int depth,
+                        const std::optional<KeyType> &lower,
+                        const std::optional<KeyType> &upper,
+                        sjtu::vector<page_id_t> *leaves,
+                        BPlusTreeStats *stats) -> int;
+
     // member variable
     std::string index_name_;
     BufferPoolManager *bpm_;
@@ -96,6 +393,169 @@ namespace sjtu {
     std::vector<std::string> log; // NOLINT
     int leaf_max_size_;
     int internal_max_size_;
+    bool counted_;
+    UnderflowPolicy underflow_policy_{UnderflowPolicy::Eager};
     page_id_t header_page_id_;
+    // Copy of the root page id in the header page.
+    page_id_t root_page_id_;
+    // Upper internal pages kept pinned, see ReadNode.
+    sjtu::vector<std::optional<ReadPageGuard>> pinned_;
+    BloomFilter bloom_;
+    int bloom_bits_per_key_{0};
+    InsertHint hint_;
+    sjtu::vector<Snapshot *> snapshots_;
+    // Open snapshots reading each page copy.
+    sjtu::map<page_id_t, int> copy_refs_;
+    int next_snapshot_id_{0};
   };
+
+  /**
+   * @brief Modify the value associated with key in place
+   *
+   * Descends once, calls `mutator(ValueType &)` on the stored value under the
+   * leaf's write guard and leaves every other page untouched. The key itself
+   * must not be changed by the mutator.
+   *
+   * @return true if key exists
+   */
+  INDEX_TEMPLATE_ARGUMENTS
+  template <typename Mutator>
+  auto BPLUSTREE_TYPE::Update(const KeyType &key, Mutator &&mutator) -> bool {
+    if (!MayContain(key)) {
+      return false;
+    }
+    auto leaf_guard = FindLeafPage(key);
+    if (!leaf_guard.has_value()) {
+      return false;
+    }
+    auto leaf_view = leaf_guard->template As<LeafPage>();
+    auto index = leaf_view->KeyIndex(key, comparator_);
+    if (index == leaf_view->GetSize() ||
+        comparator_(key, leaf_view->KeyAt(index)) != 0) {
+      return false;
+    }
+    auto leaf_page_id = leaf_guard->GetPageId();
+    leaf_guard->Drop();
+    auto write_guard = WriteNode(leaf_page_id);
+    if constexpr (LeafPage::SLOTTED) {
+      // Slotted leaves only hold encoded values, mutate a decoded copy and
+      // store it back, through Upsert if it grew out of its page.
+      auto leaf_page = write_guard.template AsMut<LeafPage>();
+      ValueType value = leaf_page->RidAt(index);
+      mutator(value);
+      if (!leaf_page->SetRidAt(index, value)) {
+        write_guard.Drop();
+        Upsert(key, value);
+      }
+    } else {
+      mutator(write_guard.template AsMut<LeafPage>()->RidAtMut(index));
+    }
+    return true;
+  }
+
+  /**
+   * @brief Visit every entry whose key matches prefix under the degraded
+   * comparator, in key order
+   *
+   * `visitor(const KeyType &, const ValueType &) -> bool` is called with
+   * references into the pinned leaf page, so filters and projections run
+   * without copying records out; returning false stops the scan. The tree
+   * must not be modified from inside the visitor.
+   *
+   * @return number of entries visited
+   */
+  INDEX_TEMPLATE_ARGUMENTS
+  template <typename Visitor>
+  auto BPLUSTREE_TYPE::Scan(const KeyType &prefix, Visitor &&visitor) -> int {
+    auto leaf_guard = FindLeafPage(prefix);
+    if (!leaf_guard.has_value()) {
+      return 0;
+    }
+    auto index = leaf_guard->template As<LeafPage>()->KeyIndex(
+        prefix, degraded_comparator_);
+    int count = 0;
+    for (Iterator it(bpm_, std::move(leaf_guard).value(), index); !it.IsEnd();
+         it.Next()) {
+      if (degraded_comparator_(prefix, it.Key()) != 0) {
+        break;
+      }
+      ++count;
+      if (!visitor(it.Key(), it.Value())) {
+        break;
+      }
+    }
+    return count;
+  }
+
+  /**
+   * @brief Same as Scan, against the pages of a snapshot
+   *
+   * Each leaf is copied out of the buffer pool before its entries are
+   * visited, so the visitor is free to insert into or remove from the tree,
+   * even entries of the leaf being visited.
+   *
+   * @return number of entries visited
+   */
+  INDEX_TEMPLATE_ARGUMENTS
+  template <typename Visitor>
+  auto BPLUSTREE_TYPE::ScanSnapshot(int snapshot_id, const KeyType &prefix,
+                                    Visitor &&visitor) -> int {
+    const Snapshot *snapshot = FindSnapshot(snapshot_id);
+    if (snapshot == nullptr || snapshot->root_page_id_ == INVALID_PAGE_ID) {
+      return 0;
+    }
+    alignas(8) char leaf_data[SJTU_PAGE_SIZE];
+    auto guard = ReadSnapshotPage(*snapshot, snapshot->root_page_id_);
+    while (!guard.template As<BPlusTreePage>()->IsLeafPage()) {
+      auto page = guard.template As<InternalPage>();
+      guard = ReadSnapshotPage(*snapshot, page->ValueAt(page->LookUp(prefix, comparator_)));
+    }
+    std::memcpy(leaf_data, guard.GetData(), SJTU_PAGE_SIZE);
+    guard.Drop();
+    auto leaf = reinterpret_cast<const LeafPage *>(leaf_data);
+    int count = 0;
+    for (int index = leaf->KeyIndex(prefix, degraded_comparator_);; ++index) {
+      if (index == leaf->GetSize()) {
+        auto next_page_id = leaf->GetNextPageId();
+        if (next_page_id == INVALID_PAGE_ID) {
+          break;
+        }
+        std::memcpy(leaf_data, ReadSnapshotPage(*snapshot, next_page_id).GetData(),
+                    SJTU_PAGE_SIZE);
+        index = -1;
+        continue;
+      }
+      if (degraded_comparator_(prefix, leaf->KeyAt(index)) != 0) {
+        break;
+      }
+      ++count;
+      if (!visitor(leaf->KeyAt(index), leaf->RidAt(index))) {
+        break;
+      }
+    }
+    return count;
+  }
+
+  /**
+   * @brief Same as Scan, but walks the entries matching prefix from the last
+   * one backwards through the leaves' prev pointers
+   *
+   * @return number of entries visited
+   */
+  INDEX_TEMPLATE_ARGUMENTS
+  template <typename Visitor>
+  auto BPLUSTREE_TYPE::ScanReverse(const KeyType &prefix, Visitor &&visitor)
+    -> int {
+    int count = 0;
+    for (auto it = SeekLast(prefix); !it.IsEnd(); it.Prev()) {
+      if (degraded_comparator_(prefix, it.Key()) != 0) {
+        break;
+      }
+      ++count;
+      if (!visitor(it.Key(), it.Value())) {
+        break;
+      }
+    }
+    return count;
+  }
 } // namespace bustub
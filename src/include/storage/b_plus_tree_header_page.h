@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common/config.h"
+#include "storage/bloom_filter.h"
 
 namespace sjtu {
   /**
@@ -17,5 +18,11 @@ namespace sjtu {
     page_id_t next_page_id_;
 
     page_id_t root_page_id_;
+
+    // Non-zero if internal pages keep subtree entry counts, fixed at creation.
+    int counted_;
+
+    // Bloom filter of the keys, see BPlusTree::EnableBloomFilter.
+    BloomFilterHeader bloom_;
   };
 } // namespace sjtu
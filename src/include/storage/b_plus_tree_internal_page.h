@@ -3,6 +3,7 @@
 #include <string>
 
 #include "storage/b_plus_tree_page.h"
+#include "storage/key_search.h"
 
 namespace sjtu {
 #define B_PLUS_TREE_INTERNAL_PAGE_TYPE BPlusTreeInternalPage<KeyType, ValueType, KeyComparator, DegradedKeyComparator>
@@ -28,6 +29,13 @@ namespace sjtu {
    *  ---------------------------------------------
    * | PAGE_ID(1) | PAGE_ID(2) | ... | PAGE_ID(n) |
    *  ---------------------------------------------
+   *  ---------------------------------------------
+   * | COUNT(1) | COUNT(2) | ... | COUNT(n) |  (counted pages only)
+   *  ---------------------------------------------
+   *
+   * Each column is MaxSize long and the columns are packed back to back, so a
+   * counted page trades a few slots for COUNT(i), the number of entries stored
+   * in the subtree under PAGE_ID(i).
    */
   INDEX_TEMPLATE_ARGUMENTS
   class BPlusTreeInternalPage : public BPlusTreePage {
@@ -37,9 +45,22 @@ namespace sjtu {
 
     BPlusTreeInternalPage(const BPlusTreeInternalPage &other) = delete;
 
-    void Init(int max_size = INTERNAL_PAGE_SLOT_CNT);
+    // Entries are shifted and moved between pages as raw bytes.
+    static_assert(IsPageCopyable<KeyType>::value, "internal keys must be trivially copyable");
+
+    // Slot count of a plain page.
+    static constexpr int SLOT_CNT = INTERNAL_PAGE_SLOT_CNT;
+
+    // Slot count of a counted page, which also stores one count per child.
+    static constexpr int COUNTED_SLOT_CNT =
+        static_cast<int>(INTERNAL_PAGE_SLOT_CNT * (sizeof(KeyType) + sizeof(ValueType)) /
+                         (sizeof(KeyType) + sizeof(ValueType) + sizeof(int)));
+
+    void Init(int max_size = INTERNAL_PAGE_SLOT_CNT, bool counted = false);
+
+    auto IsCounted() const -> bool;
 
-    auto KeyAt(int index) const -> KeyType;
+    auto KeyAt(int index) const -> const KeyType &;
 
     void SetKeyAt(int index, const KeyType &key);
 
@@ -53,9 +74,74 @@ namespace sjtu {
 
     void SetValueAt(int index, const ValueType &value);
 
+    /**
+     * @return number of entries under child `index`, 0 on pages that are not
+     * counted
+     */
+    auto CountAt(int index) const -> int;
+
+    // Does nothing on pages that are not counted.
+    void SetCountAt(int index, int count);
+
+    // Number of entries in the whole subtree.
+    auto CountSum() const -> int;
+
+    // Insert an entry before index, shifting the later entries back. The
+    // page must not be full.
+    void InsertAt(int index, const KeyType &key, const ValueType &value, int count);
+
+    // Remove the entry at index, shifting the later entries forward.
+    void RemoveAt(int index);
+
+    // Append entries [begin, GetSize()) to recipient, which must be able to
+    // hold them, and drop them from this page. KEY(begin) becomes a valid key
+    // of recipient unless recipient is empty.
+    void MoveTailTo(BPlusTreeInternalPage *recipient, int begin);
+
+    /**
+     * @return index of the child whose subtree may contain `key`, i.e. the
+     * last index i with KEY(i) <= key (index 0 if every valid key is greater)
+     */
+    template <typename Comparator>
+    auto LookUp(const KeyType &key, const Comparator &comparator) const -> int {
+      return KeyUpperBound(KeyArray(), 1, GetSize(), key, comparator) - 1;
+    }
+
+    /**
+     * @return the last index i with KEY(i) < key (index 0 if every valid key
+     * is not less), i.e. the child holding the last entry less than `key`
+     */
+    template <typename Comparator>
+    auto LookUpBefore(const KeyType &key, const Comparator &comparator) const
+        -> int {
+      return KeyLowerBound(KeyArray(), 1, GetSize(), key, comparator) - 1;
+    }
+
   private:
-    // Array members for page data.
-    KeyType key_array_[INTERNAL_PAGE_SLOT_CNT];
-    ValueType page_id_array_[INTERNAL_PAGE_SLOT_CNT];
+    auto KeyArray() const -> const KeyType * {
+      return reinterpret_cast<const KeyType *>(data_);
+    }
+
+    auto KeyArray() -> KeyType * { return reinterpret_cast<KeyType *>(data_); }
+
+    auto PageIdArray() const -> const ValueType * {
+      return reinterpret_cast<const ValueType *>(data_ + GetMaxSize() * sizeof(KeyType));
+    }
+
+    auto PageIdArray() -> ValueType * {
+      return reinterpret_cast<ValueType *>(data_ + GetMaxSize() * sizeof(KeyType));
+    }
+
+    auto CountArray() const -> const int * {
+      return reinterpret_cast<const int *>(data_ + GetMaxSize() * (sizeof(KeyType) + sizeof(ValueType)));
+    }
+
+    auto CountArray() -> int * {
+      return reinterpret_cast<int *>(data_ + GetMaxSize() * (sizeof(KeyType) + sizeof(ValueType)));
+    }
+
+    int counted_;
+    // Key, page id and count columns, laid out by MaxSize.
+    alignas(KeyType) char data_[INTERNAL_PAGE_SLOT_CNT * (sizeof(KeyType) + sizeof(ValueType))];
   };
 } // namespace sjtu
@@ -1,13 +1,19 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <type_traits>
 #include <utility>
 
+#include "common/vector.h"
 #include "storage/b_plus_tree_page.h"
+#include "storage/key_search.h"
+#include "storage/record_codec.h"
 
 namespace sjtu {
 #define B_PLUS_TREE_LEAF_PAGE_TYPE BPlusTreeLeafPage<KeyType, ValueType, KeyComparator, DegradedKeyComparator>
 #define LEAF_PAGE_HEADER_SIZE 24
+#define LEAF_PAGE_DATA_SIZE (SJTU_PAGE_SIZE - LEAF_PAGE_HEADER_SIZE)
 #define LEAF_PAGE_SLOT_CNT ((SJTU_PAGE_SIZE - LEAF_PAGE_HEADER_SIZE) / (sizeof(KeyType) + sizeof(ValueType)))
 
   /**
@@ -15,7 +21,7 @@ namespace sjtu {
    * see `include/common/rid.h` for detailed implementation) together within leaf
    * page. Only support unique key.
    *
-   * Leaf page format (keys are stored in order):
+   * Leaf page format of fixed-width values (keys are stored in order):
    *  ---------
    * | HEADER |
    *  ---------
@@ -26,41 +32,179 @@ namespace sjtu {
    * | RID(1) | RID(2) | ... | RID(n) |
    *  ---------------------------------
    *
-   *  Header format (size in byte, 16 bytes in total):
+   * Values whose RecordCodec is VARIABLE_LENGTH use a slotted layout instead.
+   * The key column is followed by a slot directory of (offset, length) pairs
+   * into a payload heap that grows down from the end of the page:
+   *  ---------------------------------------------------------------
+   * | HEADER | KEY(1..n) | SLOT(1..n) | free | ... PAYLOAD(i) ... |
+   *  ---------------------------------------------------------------
+   * Both columns are n entries long and move up as the page grows, so keys
+   * stay contiguous for searching. Such pages are full when their bytes run
+   * out rather than at MaxSize.
+   *
+   *  Header format (size in byte, 24 bytes in total):
    *  -----------------------------------------------
    * | PageType (4) | CurrentSize (4) | MaxSize (4) |
    *  -----------------------------------------------
-   *  -----------------
-   * | NextPageId (4) |
-   *  -----------------
+   *  ------------------------------------------------------------------
+   * | NextPageId (4) | PrevPageId (4) | HeapTop (2) | HeapUsed (2) |
+   *  ------------------------------------------------------------------
    */
   INDEX_TEMPLATE_ARGUMENTS
   class BPlusTreeLeafPage : public BPlusTreePage {
+    using Codec = RecordCodec<ValueType>;
+
+    struct Slot {
+      uint16_t offset_;
+      uint16_t length_;
+    };
+
   public:
     // Delete all constructor / destructor to ensure memory safety
     BPlusTreeLeafPage() = delete;
 
     BPlusTreeLeafPage(const BPlusTreeLeafPage &other) = delete;
 
-    void Init(int max_size = LEAF_PAGE_SLOT_CNT);
+    static constexpr bool SLOTTED = Codec::VARIABLE_LENGTH;
+
+    // Entries are shifted and moved between pages as raw bytes.
+    static_assert(IsPageCopyable<KeyType>::value, "leaf keys must be trivially copyable");
+    static_assert(SLOTTED || IsPageCopyable<ValueType>::value,
+                  "fixed-width leaf values must be trivially copyable");
+
+    // Slot count of a page, for slotted pages the count that fits when every
+    // payload has the minimum length.
+    static constexpr int SLOT_CNT = [] {
+      if constexpr (SLOTTED) {
+        return static_cast<int>(LEAF_PAGE_DATA_SIZE /
+                                (sizeof(KeyType) + sizeof(Slot) + Codec::MIN_SIZE));
+      } else {
+        return static_cast<int>(LEAF_PAGE_SLOT_CNT);
+      }
+    }();
+
+    // Values are decoded out of slotted pages, other pages return references.
+    using ValueRef = std::conditional_t<SLOTTED, ValueType, const ValueType &>;
+
+    void Init(int max_size = SLOT_CNT);
 
     // Helper methods
     auto GetNextPageId() const -> page_id_t;
 
     void SetNextPageId(page_id_t next_page_id);
 
-    auto KeyAt(int index) const -> KeyType;
+    auto GetPrevPageId() const -> page_id_t;
+
+    void SetPrevPageId(page_id_t prev_page_id);
 
-    auto RidAt(int index) const -> ValueType;
+    auto KeyAt(int index) const -> const KeyType &;
+
+    auto RidAt(int index) const -> ValueRef;
+
+    // Only available on pages of fixed-width values.
+    auto RidAtMut(int index) -> ValueType &
+      requires(!SLOTTED);
+
+    /**
+     * @return index of the first key that is not less than `key` under
+     * `comparator`, GetSize() if there is none
+     */
+    template <typename Comparator>
+    auto KeyIndex(const KeyType &key, const Comparator &comparator) const
+        -> int {
+      return KeyLowerBound(KeyArray(), 0, GetSize(), key, comparator);
+    }
+
+    /**
+     * @return index of the first key that is greater than `key` under
+     * `comparator`, GetSize() if there is none
+     */
+    template <typename Comparator>
+    auto KeyUpperIndex(const KeyType &key, const Comparator &comparator) const
+        -> int {
+      return KeyUpperBound(KeyArray(), 0, GetSize(), key, comparator);
+    }
 
     void SetKeyAt(int index, const KeyType &key);
 
-    void SetRidAt(int index, const ValueType &value);
+    /**
+     * @brief Overwrite the value at index
+     *
+     * @return false if a slotted page has no room for the longer payload, in
+     * which case the page is unchanged
+     */
+    auto SetRidAt(int index, const ValueType &value) -> bool;
+
+    // Insert an entry before index, the page must be able to hold it.
+    void InsertAt(int index, const KeyType &key, const ValueType &value);
+
+    void RemoveAt(int index);
+
+    // Append entries [begin, GetSize()) to recipient, which must be able to
+    // hold them, and drop them from this page.
+    void MoveTailTo(BPlusTreeLeafPage *recipient, int begin);
+
+    // Replace the whole content by entries [begin, begin + size) of keys and
+    // values, which must fit into the page.
+    void Assign(const sjtu::vector<KeyType> &keys,
+                const sjtu::vector<ValueType> &values, int begin, int size);
+
+    /**
+     * Space accounting shared by both layouts. Fixed-width pages count
+     * entries against MaxSize, slotted pages count the bytes of key, slot and
+     * payload against the data area.
+     */
+    static auto EntryCost(const ValueType &value) -> int;
+
+    // EntryCost of the entry at index.
+    auto EntryCostAt(int index) const -> int;
+
+    auto Capacity() const -> int;
+
+    auto Load() const -> int;
+
+    // Load below which the page counts as underfull.
+    auto MinLoad() const -> int;
+
+    auto CanHold(const ValueType &value) const -> bool;
 
   private:
+    auto KeyArray() const -> const KeyType * {
+      return reinterpret_cast<const KeyType *>(data_);
+    }
+
+    auto KeyArray() -> KeyType * { return reinterpret_cast<KeyType *>(data_); }
+
+    auto RidArray() const -> const ValueType * {
+      return reinterpret_cast<const ValueType *>(data_ + LEAF_PAGE_SLOT_CNT * sizeof(KeyType));
+    }
+
+    auto RidArray() -> ValueType * {
+      return reinterpret_cast<ValueType *>(data_ + LEAF_PAGE_SLOT_CNT * sizeof(KeyType));
+    }
+
+    auto SlotArray() const -> const Slot * {
+      return reinterpret_cast<const Slot *>(data_ + GetSize() * sizeof(KeyType));
+    }
+
+    auto SlotArray() -> Slot * {
+      return reinterpret_cast<Slot *>(data_ + GetSize() * sizeof(KeyType));
+    }
+
+    // Bytes between the slot directory and the payload heap.
+    auto FreeGap() const -> int;
+
+    // Move live payloads to the end of the page, dropping the holes left by
+    // removed and shrunk values.
+    void Compact();
+
     page_id_t next_page_id_;
-    // Array members for page data.
-    KeyType key_array_[LEAF_PAGE_SLOT_CNT];
-    ValueType rid_array_[LEAF_PAGE_SLOT_CNT];
+    page_id_t prev_page_id_;
+    // Start of the payload heap and the bytes of it still referenced, slotted
+    // pages only.
+    uint16_t heap_top_;
+    uint16_t heap_used_;
+    // Key and value columns, or keys, slots and payload heap.
+    alignas(KeyType) alignas(ValueType) char data_[LEAF_PAGE_DATA_SIZE];
   };
 } // namespace sjtu
@@ -4,6 +4,8 @@
 #include <climits>
 #include <cstdlib>
 #include <string>
+#include <type_traits>
+#include <utility>
 
 #include "buffer/buffer_pool_manager.h"
 
@@ -12,6 +14,19 @@ namespace sjtu {
 
 #define INDEX_TEMPLATE_ARGUMENTS template <typename KeyType, typename ValueType, typename KeyComparator, typename DegradedKeyComparator>
 
+  /**
+   * Whether keys and values of type T may be moved between and within pages
+   * with memcpy / memmove. std::pair is not trivially copyable only because
+   * its assignment operators are user-provided, a pair of such types is still
+   * copied member by member.
+   */
+  template <typename T>
+  struct IsPageCopyable : std::is_trivially_copyable<T> {};
+
+  template <typename First, typename Second>
+  struct IsPageCopyable<std::pair<First, Second> >
+      : std::bool_constant<IsPageCopyable<First>::value && IsPageCopyable<Second>::value> {};
+
   // define page type enum
   enum class IndexPageType { INVALID_INDEX_PAGE = 0, LEAF_PAGE, INTERNAL_PAGE };
 
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/config.h"
+#include "common/util.h"
+#include "common/vector.h"
+
+namespace sjtu {
+  /**
+   * Where a tree keeps its Bloom filter, embedded in the tree's header page.
+   * A zeroed block (an index file older than the filter) reads as "no usable
+   * filter" and makes the tree rebuild it.
+   */
+  struct BloomFilterHeader {
+    // First of page_cnt_ consecutive pages holding the bit array.
+    page_id_t page_id_;
+    int page_cnt_;
+    int word_cnt_;
+    int hash_cnt_;
+    // Keys the bit array was sized for.
+    int capacity_;
+    // Keys added and removed since the filter was last built.
+    int key_cnt_;
+    int removed_cnt_;
+    // Non-zero only while the saved bits match the tree, i.e. between a clean
+    // shutdown and the next open.
+    int clean_;
+  };
+
+  /**
+   * Bloom filter over key hashes. MayContain never answers false for a hash
+   * that was added, so a negative answer lets a lookup skip the tree.
+   *
+   * The filter cannot forget keys. Removes only bump a counter, and the owner
+   * rebuilds the filter from the keys it actually holds once the counters say
+   * the filter got too crowded.
+   */
+  class BloomFilter {
+  public:
+    // Clear the filter and size it for capacity keys.
+    void Reset(int capacity, int bits_per_key);
+
+    void Add(uint64_t hash);
+
+    auto MayContain(uint64_t hash) const -> bool;
+
+    void NoteRemove(int cnt = 1) { removed_cnt_ += cnt; }
+
+    auto IsEnabled() const -> bool { return !bits_.empty(); }
+
+    // Whether the filter should be rebuilt: too many keys for its size, or
+    // too many of them removed.
+    auto NeedsRebuild() const -> bool;
+
+    auto Capacity() const -> int { return capacity_; }
+
+    auto KeyCount() const -> int { return key_cnt_; }
+
+    /**
+     * @brief Read the bit array described by header out of bpm
+     *
+     * @return false if header does not describe a clean filter sized for
+     * bits_per_key, in which case the filter is left disabled
+     */
+    auto Load(BufferPoolManager *bpm, const BloomFilterHeader &header, int bits_per_key) -> bool;
+
+    // Write the bit array into bpm, taking new pages if the ones in header
+    // are too few, and record it as clean in header.
+    void Save(BufferPoolManager *bpm, BloomFilterHeader *header) const;
+
+  private:
+    sjtu::vector<uint64_t> bits_;
+    int hash_cnt_{0};
+    int capacity_{0};
+    int key_cnt_{0};
+    int removed_cnt_{0};
+  };
+} // namespace sjtu
@@ -0,0 +1,121 @@
+/**
+ * extendible_hash_table.h
+ *
+ * Disk-based extendible hash table for tables that are only accessed by exact
+ * key. A header page routes a hash to a directory page, which routes it to a
+ * bucket page; full buckets split and empty buckets merge with their split
+ * image, growing and shrinking the directory as needed.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/config.h"
+#include "common/util.h"
+#include "common/vector.h"
+#include "storage/extendible_htable_bucket_page.h"
+#include "storage/extendible_htable_directory_page.h"
+#include "storage/extendible_htable_header_page.h"
+#include "storage/page_guard.h"
+
+namespace sjtu {
+#define EXTENDIBLE_HASH_TABLE_TYPE ExtendibleHashTable<KeyType, ValueType, KeyComparator>
+
+  HTABLE_TEMPLATE_ARGUMENTS
+  class ExtendibleHashTable {
+    using BucketPage = ExtendibleHTableBucketPage<KeyType, ValueType, KeyComparator>;
+
+  public:
+    static constexpr int BUCKET_MAX_SIZE = BucketPage::SLOT_CNT;
+
+    /**
+     * @param header_max_depth hash bits that pick a directory page, at most
+     * HTABLE_HEADER_MAX_DEPTH; only honored when the file is created
+     * @param directory_max_depth hash bits a directory page may use to pick a
+     * bucket, at most HTABLE_DIRECTORY_MAX_DEPTH
+     */
+    explicit ExtendibleHashTable(std::string name, const KeyComparator &comparator,
+                                 int bpm_max_size = BUFFER_POOL_SIZE,
+                                 int header_max_depth = HTABLE_HEADER_DEPTH,
+                                 int directory_max_depth = HTABLE_DIRECTORY_MAX_DEPTH,
+                                 int bucket_max_size = BUCKET_MAX_SIZE);
+
+    ~ExtendibleHashTable();
+
+    // Returns true if this table has no keys and values.
+    auto IsEmpty() const -> bool;
+
+    /**
+     * Insert a key-value pair.
+     *
+     * @return false if the key exists, or if its bucket is full and can no
+     * longer split because its directory reached directory_max_depth
+     */
+    auto Insert(const KeyType &key, const ValueType &value) -> bool;
+
+    // Insert a key-value pair, overwriting the value if the key exists.
+    auto Upsert(const KeyType &key, const ValueType &value) -> bool;
+
+    // Apply mutator to the value associated with key in place.
+    template <typename Mutator>
+    auto Update(const KeyType &key, Mutator &&mutator) -> bool;
+
+    // Remove a key and its value, returns false if the key does not exist.
+    auto Remove(const KeyType &key) -> bool;
+
+    // Return the value associated with a given key
+    auto GetValue(const KeyType &key, sjtu::vector<ValueType> *result) -> bool;
+
+  private:
+    auto Hash(const KeyType &key) const -> uint32_t;
+
+    auto InsertImpl(const KeyType &key, const ValueType &value, bool overwrite) -> bool;
+
+    // Page id of the bucket that may hold hash, INVALID_PAGE_ID if its
+    // directory does not exist yet.
+    auto FindBucketPageId(uint32_t hash) -> page_id_t;
+
+    auto NewBucketPage() -> page_id_t;
+
+    // Split the full bucket at bucket_idx, false if the directory is full.
+    auto SplitBucket(ExtendibleHTableDirectoryPage *directory, uint32_t bucket_idx) -> bool;
+
+    // Merge the bucket at bucket_idx with its split image for as long as one
+    // of the two is empty, then shrink the directory.
+    void MergeBuckets(ExtendibleHTableDirectoryPage *directory, uint32_t bucket_idx);
+
+    std::string index_name_;
+    BufferPoolManager *bpm_;
+    KeyComparator comparator_;
+    int directory_max_depth_;
+    int bucket_max_size_;
+    page_id_t header_page_id_;
+  };
+
+  /**
+   * @brief Modify the value associated with key in place
+   *
+   * Only the bucket page gets dirty. The key itself must not be changed by
+   * the mutator.
+   *
+   * @return true if key exists
+   */
+  HTABLE_TEMPLATE_ARGUMENTS
+  template <typename Mutator>
+  auto EXTENDIBLE_HASH_TABLE_TYPE::Update(const KeyType &key, Mutator &&mutator) -> bool {
+    auto bucket_page_id = FindBucketPageId(Hash(key));
+    if (bucket_page_id == INVALID_PAGE_ID) {
+      return false;
+    }
+    auto bucket_guard = bpm_->WritePage(bucket_page_id);
+    auto bucket_page = bucket_guard.template AsMut<BucketPage>();
+    auto index = bucket_page->Lookup(key, comparator_);
+    if (index < 0) {
+      return false;
+    }
+    mutator(bucket_page->ValueAtMut(index));
+    return true;
+  }
+} // namespace sjtu
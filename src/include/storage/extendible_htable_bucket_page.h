@@ -0,0 +1,66 @@
+#pragma once
+
+#include <utility>
+
+#include "common/config.h"
+
+namespace sjtu {
+#define HTABLE_TEMPLATE_ARGUMENTS template <typename KeyType, typename ValueType, typename KeyComparator>
+#define EXTENDIBLE_HTABLE_BUCKET_PAGE_TYPE ExtendibleHTableBucketPage<KeyType, ValueType, KeyComparator>
+#define HTABLE_BUCKET_PAGE_HEADER_SIZE 8
+#define HTABLE_BUCKET_SLOT_CNT \
+  ((SJTU_PAGE_SIZE - HTABLE_BUCKET_PAGE_HEADER_SIZE) / ((int)(sizeof(std::pair<KeyType, ValueType>))))  // NOLINT
+
+  /**
+   * Bucket page of an extendible hash table, an unordered array of unique
+   * (key, value) pairs.
+   *
+   * Bucket format (size in byte):
+   *  ---------------------------------
+   * | CurrentSize (4) | MaxSize (4) |
+   *  ---------------------------------
+   *  -----------------------------------------------
+   * | (KEY(1), VALUE(1)) | ... | (KEY(n), VALUE(n)) |
+   *  -----------------------------------------------
+   */
+  HTABLE_TEMPLATE_ARGUMENTS
+  class ExtendibleHTableBucketPage {
+    using EntryType = std::pair<KeyType, ValueType>;
+
+  public:
+    // Delete all constructor / destructor to ensure memory safety
+    ExtendibleHTableBucketPage() = delete;
+
+    ExtendibleHTableBucketPage(const ExtendibleHTableBucketPage &other) = delete;
+
+    static constexpr int SLOT_CNT = HTABLE_BUCKET_SLOT_CNT;
+
+    void Init(int max_size = SLOT_CNT);
+
+    // @return index of key, -1 if the bucket does not hold it
+    auto Lookup(const KeyType &key, const KeyComparator &cmp) const -> int;
+
+    // Append an entry, the bucket must not be full nor hold key already.
+    void InsertAt(const KeyType &key, const ValueType &value);
+
+    // Remove the entry at index by moving the last entry into its place.
+    void RemoveAt(int index);
+
+    auto KeyAt(int index) const -> const KeyType &;
+
+    auto ValueAt(int index) const -> const ValueType &;
+
+    auto ValueAtMut(int index) -> ValueType &;
+
+    auto Size() const -> int;
+
+    auto IsFull() const -> bool;
+
+    auto IsEmpty() const -> bool;
+
+  private:
+    int size_;
+    int max_size_;
+    EntryType array_[HTABLE_BUCKET_SLOT_CNT];
+  };
+} // namespace sjtu
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+
+#include "common/config.h"
+
+namespace sjtu {
+#define HTABLE_DIRECTORY_ARRAY_SIZE (1 << HTABLE_DIRECTORY_MAX_DEPTH)
+
+  /**
+   * Directory page of an extendible hash table. Slot i holds the bucket of
+   * the hashes whose lower global_depth bits are i; a bucket of local depth d
+   * is shared by the 2^(global_depth - d) slots that agree on the lower d
+   * bits.
+   *
+   * Directory format (size in byte):
+   *  ---------------------------------------------
+   * | MaxDepth (4) | GlobalDepth (4) |
+   *  ---------------------------------------------
+   *  ---------------------------------------------
+   * | LocalDepth(0) | ... | LocalDepth(2^MaxDepth - 1) |  (1 byte each)
+   *  ---------------------------------------------
+   *  ---------------------------------------------
+   * | BucketPageId(0) | ... | BucketPageId(2^MaxDepth - 1) |
+   *  ---------------------------------------------
+   */
+  class ExtendibleHTableDirectoryPage {
+  public:
+    // Delete all constructor / destructor to ensure memory safety
+    ExtendibleHTableDirectoryPage() = delete;
+
+    ExtendibleHTableDirectoryPage(const ExtendibleHTableDirectoryPage &other) = delete;
+
+    /**
+     * Start with global depth 0, the caller sets the page of bucket 0.
+     *
+     * @param max_depth bound of the global depth, at most
+     * HTABLE_DIRECTORY_MAX_DEPTH
+     */
+    void Init(int max_depth);
+
+    auto HashToBucketIndex(uint32_t hash) const -> uint32_t;
+
+    auto GetBucketPageId(uint32_t bucket_idx) const -> page_id_t;
+
+    void SetBucketPageId(uint32_t bucket_idx, page_id_t bucket_page_id);
+
+    // Slot that differs from bucket_idx in the highest bit of its local depth.
+    auto GetSplitImageIndex(uint32_t bucket_idx) const -> uint32_t;
+
+    auto GetGlobalDepth() const -> int;
+
+    auto GetMaxDepth() const -> int;
+
+    // Double the directory, the new upper half mirrors the lower one.
+    void IncrGlobalDepth();
+
+    void DecrGlobalDepth();
+
+    // True if every bucket has a local depth below the global depth.
+    auto CanShrink() const -> bool;
+
+    auto Size() const -> uint32_t;
+
+    auto GetLocalDepth(uint32_t bucket_idx) const -> int;
+
+    void SetLocalDepth(uint32_t bucket_idx, int local_depth);
+
+  private:
+    int max_depth_;
+    int global_depth_;
+    uint8_t local_depths_[HTABLE_DIRECTORY_ARRAY_SIZE];
+    page_id_t bucket_page_ids_[HTABLE_DIRECTORY_ARRAY_SIZE];
+  };
+} // namespace sjtu
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+#include "common/config.h"
+
+namespace sjtu {
+#define HTABLE_HEADER_ARRAY_SIZE (1 << HTABLE_HEADER_MAX_DEPTH)
+
+  /**
+   * First page of an extendible hash table, routing hashes to directory
+   * pages by their upper max_depth bits. Directory pages are only created
+   * once a hash maps to them.
+   *
+   * Header format (size in byte):
+   *  ---------------------------------------------------------
+   * | NextPageId (4) | EntryCount (4) | MaxDepth (4) |
+   *  ---------------------------------------------------------
+   *  ---------------------------------------------------------
+   * | DirectoryPageId(0) | ... | DirectoryPageId(2^MaxDepth - 1) |
+   *  ---------------------------------------------------------
+   */
+  class ExtendibleHTableHeaderPage {
+  public:
+    // Delete all constructor / destructor to ensure memory safety
+    ExtendibleHTableHeaderPage() = delete;
+
+    ExtendibleHTableHeaderPage(const ExtendibleHTableHeaderPage &other) = delete;
+
+    /**
+     * @param max_depth number of hash bits used to pick a directory, between
+     * 1 and HTABLE_HEADER_MAX_DEPTH
+     */
+    void Init(int max_depth);
+
+    // A header page that was never initialized reads as all zero.
+    auto IsInitialized() const -> bool { return max_depth_ != 0; }
+
+    auto HashToDirectoryIndex(uint32_t hash) const -> uint32_t;
+
+    auto GetDirectoryPageId(uint32_t directory_idx) const -> page_id_t;
+
+    void SetDirectoryPageId(uint32_t directory_idx, page_id_t directory_page_id);
+
+    auto MaxSize() const -> uint32_t;
+
+    page_id_t next_page_id_;
+
+    // Entries stored in the whole table.
+    int entry_cnt_;
+
+  private:
+    int max_depth_;
+    page_id_t directory_page_ids_[HTABLE_HEADER_ARRAY_SIZE];
+  };
+} // namespace sjtu
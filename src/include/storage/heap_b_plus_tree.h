@@ -0,0 +1,107 @@
+#pragma once
+
+#include <string>
+
+#include "common/rid.h"
+#include "common/vector.h"
+#include "storage/b_plus_tree.h"
+#include "storage/heap_file.h"
+
+namespace sjtu {
+#define HEAP_BPLUSTREE_TYPE HeapBPlusTree<KeyType, ValueType, KeyComparator, DegradedKeyComparator>
+
+  /**
+   * B+ tree whose leaves store record ids instead of values.
+   *
+   * The values live in a HeapFile next to the index, so the index keeps the
+   * fan-out of a (key, RID) tree however large the values are, and rewriting
+   * a value touches one heap page unless the record has to move. Point
+   * lookups and scans pay one heap page read per value.
+   *
+   * Supports the subset of the BPlusTree interface that makes sense without
+   * values in the leaves, with the same semantics.
+   */
+  INDEX_TEMPLATE_ARGUMENTS
+  class HeapBPlusTree {
+    using Index = BPlusTree<KeyType, RID, KeyComparator, DegradedKeyComparator>;
+
+  public:
+    /**
+     * @param name index file name, the heap file is name + "_heap"
+     */
+    explicit HeapBPlusTree(const std::string &name,
+                           const KeyComparator &comparator, const DegradedKeyComparator &degraded_comparator,
+                           int bpm_max_size = BUFFER_POOL_SIZE);
+
+    auto IsEmpty() const -> bool;
+
+    auto Insert(const KeyType &key, const ValueType &value) -> bool;
+
+    auto Upsert(const KeyType &key, const ValueType &value) -> bool;
+
+    template <typename Mutator>
+    auto Update(const KeyType &key, Mutator &&mutator) -> bool;
+
+    // Keys already in the tree and repeated batch keys are skipped, as in
+    // BPlusTree::InsertBatch.
+    auto InsertBatch(const sjtu::vector<KeyType> &keys,
+                     const sjtu::vector<ValueType> &values) -> int;
+
+    void Remove(const KeyType &key);
+
+    auto GetValue(const KeyType &key, sjtu::vector<ValueType> *result) -> bool;
+
+    // BPlusTree::MultiGet on the index, then one heap read per key found.
+    auto MultiGet(const sjtu::vector<KeyType> &keys,
+                  sjtu::vector<std::optional<ValueType> > *result) -> int;
+
+    template <typename Visitor>
+    auto Scan(const KeyType &prefix, Visitor &&visitor) -> int;
+
+    // Stats of the index, the heap file is not inspected.
+    auto Stats() -> BPlusTreeStats { return index_.Stats(); }
+
+    // Compact the index, records stay where they are in the heap file.
+    void Compact(int fill_percent = BULK_FILL_PERCENT) { index_.Compact(fill_percent); }
+
+  private:
+    // @return whether key is indexed, its rid is stored in *rid
+    auto FindRid(const KeyType &key, RID *rid) -> bool;
+
+    Index index_;
+    HeapFile<ValueType> heap_;
+    KeyComparator comparator_;
+  };
+
+  /**
+   * @brief Modify the value associated with key through the heap, the index
+   * is only written if the record moves
+   *
+   * @return true if key exists
+   */
+  INDEX_TEMPLATE_ARGUMENTS
+  template <typename Mutator>
+  auto HEAP_BPLUSTREE_TYPE::Update(const KeyType &key, Mutator &&mutator) -> bool {
+    RID rid;
+    if (!FindRid(key, &rid)) {
+      return false;
+    }
+    auto new_rid = heap_.Modify(rid, mutator);
+    if (!(new_rid == rid)) {
+      index_.Upsert(key, new_rid);
+    }
+    return true;
+  }
+
+  /**
+   * @brief Visit the entries matching prefix in key order, reading each value
+   * from the heap, see BPlusTree::Scan
+   */
+  INDEX_TEMPLATE_ARGUMENTS
+  template <typename Visitor>
+  auto HEAP_BPLUSTREE_TYPE::Scan(const KeyType &prefix, Visitor &&visitor) -> int {
+    return index_.Scan(prefix, [&](const KeyType &key, const RID &rid) {
+      return visitor(key, heap_.Get(rid));
+    });
+  }
+} // namespace sjtu
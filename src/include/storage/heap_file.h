@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/config.h"
+#include "common/rid.h"
+#include "storage/heap_page.h"
+#include "storage/page_guard.h"
+#include "storage/record_codec.h"
+
+namespace sjtu {
+  /**
+   * First page of a heap file.
+   */
+  class HeapFileHeaderPage {
+  public:
+    // Delete all constructor / destructor to ensure memory safety
+    HeapFileHeaderPage() = delete;
+
+    HeapFileHeaderPage(const HeapFileHeaderPage &other) = delete;
+
+    page_id_t next_page_id_;
+
+    // Page new records are appended to.
+    page_id_t last_page_id_;
+  };
+
+  /**
+   * Unordered store of ValueType records addressed by RID, kept in its own
+   * file of HeapPages.
+   *
+   * Records are encoded through RecordCodec<ValueType> when it is
+   * VARIABLE_LENGTH and copied as they are otherwise. New records go to the
+   * last page until it is full; space freed in earlier pages is only reused by
+   * records of those pages that are rewritten.
+   */
+  template <typename ValueType>
+  class HeapFile {
+    using Codec = RecordCodec<ValueType>;
+
+  public:
+    explicit HeapFile(const std::string &name, int bpm_max_size = BUFFER_POOL_SIZE);
+
+    ~HeapFile();
+
+    auto Insert(const ValueType &value) -> RID;
+
+    auto Get(const RID &rid) -> ValueType;
+
+    /**
+     * @brief Overwrite the record at rid
+     *
+     * @return rid of the record afterwards, which only differs from rid if the
+     * record grew out of its page
+     */
+    auto Update(const RID &rid, const ValueType &value) -> RID;
+
+    // Apply mutator to the record at rid, returns its rid as Update does.
+    template <typename Mutator>
+    auto Modify(const RID &rid, Mutator &&mutator) -> RID;
+
+    void Remove(const RID &rid);
+
+  private:
+    static auto RecordSize(const ValueType &value) -> int;
+
+    static void Encode(const ValueType &value, char *dst);
+
+    static auto Decode(const char *src) -> ValueType;
+
+    BufferPoolManager *bpm_;
+    page_id_t header_page_id_;
+  };
+
+  template <typename ValueType>
+  template <typename Mutator>
+  auto HeapFile<ValueType>::Modify(const RID &rid, Mutator &&mutator) -> RID {
+    auto value = Get(rid);
+    mutator(value);
+    return Update(rid, value);
+  }
+} // namespace sjtu
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+
+#include "common/config.h"
+
+namespace sjtu {
+#define HEAP_PAGE_HEADER_SIZE 8
+
+  /**
+   * Slotted page holding the records of a heap file.
+   *
+   * Heap page format:
+   *  ---------------------------------------------------------------
+   * | HEADER | SLOT(0) | SLOT(1) | ... | free | ... RECORD(i) ... |
+   *  ---------------------------------------------------------------
+   *
+   * Slots are (offset, length) pairs indexed by the slot number of a RID, the
+   * records grow down from the end of the page. A removed record leaves its
+   * slot free for reuse, so the slot numbers of the other records never
+   * change. Offset 0 marks a free slot.
+   *
+   *  Header format (size in byte, 8 bytes in total):
+   *  ------------------------------------------------------------
+   * | SlotCount (2) | HeapTop (2) | HeapUsed (2) | FreeSlots (2) |
+   *  ------------------------------------------------------------
+   */
+  class HeapPage {
+  public:
+    // Delete all constructor / destructor to ensure memory safety
+    HeapPage() = delete;
+
+    HeapPage(const HeapPage &other) = delete;
+
+    void Init();
+
+    // Room left for one more record, including a new slot for it.
+    auto FreeSpace() const -> int;
+
+    /**
+     * @brief Store a record of length bytes
+     *
+     * @return slot number of the record, -1 if the page has no room for it
+     */
+    auto Insert(const char *data, int length) -> int;
+
+    // @return the record in slot, its length is stored in *length
+    auto Get(int slot, int *length) const -> const char *;
+
+    /**
+     * @brief Overwrite the record in slot, moving it within the page if it
+     * grew
+     *
+     * @return false if the page has no room for the longer record, in which
+     * case the page is unchanged
+     */
+    auto Update(int slot, const char *data, int length) -> bool;
+
+    void Remove(int slot);
+
+  private:
+    struct Slot {
+      uint16_t offset_;
+      uint16_t length_;
+    };
+
+    auto SlotArray() const -> const Slot * { return reinterpret_cast<const Slot *>(data_); }
+
+    auto SlotArray() -> Slot * { return reinterpret_cast<Slot *>(data_); }
+
+    // Bytes between the slot array and the record area.
+    auto FreeGap() const -> int;
+
+    // Reserve length bytes at the bottom of the record area, compacting the
+    // records first if the gap is too small.
+    auto Allocate(int length) -> uint16_t;
+
+    // Move live records to the end of the page, dropping the holes left by
+    // removed and shrunk records.
+    void Compact();
+
+    uint16_t slot_cnt_;
+    uint16_t heap_top_;
+    uint16_t heap_used_;
+    uint16_t free_slot_cnt_;
+    // Slot array and records, offsets are relative to data_.
+    char data_[SJTU_PAGE_SIZE - HEAP_PAGE_HEADER_SIZE];
+  };
+} // namespace sjtu
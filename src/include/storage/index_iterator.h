@@ -0,0 +1,62 @@
+/**
+ * index_iterator.h
+ * For range scan of b+ tree
+ */
+#pragma once
+
+#include <optional>
+
+#include "storage/b_plus_tree_leaf_page.h"
+#include "storage/page_guard.h"
+
+namespace sjtu {
+#define INDEXITERATOR_TYPE IndexIterator<KeyType, ValueType, KeyComparator, DegradedKeyComparator>
+
+  /**
+   * Bidirectional cursor over the leaf chain of a b+ tree.
+   *
+   * The cursor keeps the leaf it points into pinned, and Key() / Value() refer
+   * straight into that page, so callers can filter and project entries
+   * without copying them out. Values of slotted leaves are decoded into the
+   * cursor instead. The references are only valid until the next call to
+   * Next() or Value(). The tree must not be modified while a cursor is alive.
+   */
+  INDEX_TEMPLATE_ARGUMENTS
+  class IndexIterator {
+    using LeafPage = BPlusTreeLeafPage<KeyType, ValueType, KeyComparator, DegradedKeyComparator>;
+
+  public:
+    // Construct an end iterator.
+    IndexIterator() = default;
+
+    // Point at entry `index` of the leaf held by guard, moving on to the next
+    // leaf if index is past its last entry.
+    IndexIterator(BufferPoolManager *bpm, ReadPageGuard guard, int index);
+
+    auto IsEnd() const -> bool;
+
+    auto Key() const -> const KeyType &;
+
+    auto Value() const -> const ValueType &;
+
+    // Advance to the next entry in key order.
+    void Next();
+
+    // Step back to the previous entry in key order.
+    void Prev();
+
+  private:
+    // Skip forward until index_ is a valid entry or the chain runs out.
+    void Settle();
+
+    // Skip backward until index_ is a valid entry or the chain runs out.
+    void SettleBackward();
+
+    BufferPoolManager *bpm_{nullptr};
+    ReadPageGuard guard_;
+    const LeafPage *page_{nullptr};
+    int index_{0};
+    // Last value decoded by Value(), slotted leaves only.
+    mutable std::optional<ValueType> value_;
+  };
+} // namespace sjtu
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "common/config.h"
+#include "common/util.h"
+
+namespace sjtu {
+/**
+ * How a page locates a key inside its sorted key array.
+ *
+ * Generic    - plain binary search through the comparator.
+ * Integral   - branchless search on `hash_t` keys ordered as unsigned integers,
+ *              finished by an AVX2 scan when the build enables it.
+ * Normalized - branchless search on the normalized form of the keys, or on its
+ *              upper bits for comparators that only look at a prefix of the
+ *              members (see NormalizedCompare).
+ */
+enum class KeySearchKind { Generic, Integral, Normalized };
+
+/**
+ * Selects the search strategy for a (key, comparator) combination at compile
+ * time. Specialized strategies are only chosen when the comparator is known to
+ * implement the natural ordering of the key, anything else stays generic.
+ */
+template <typename KeyType, typename Comparator>
+struct KeySearchTraits {
+  static constexpr KeySearchKind kind = KeySearchKind::Generic;
+};
+
+template <typename KeyType, typename Comparator>
+  requires std::is_same_v<typename Comparator::NormalizedKey, KeyType>
+struct KeySearchTraits<KeyType, Comparator> {
+  static constexpr KeySearchKind kind =
+      std::is_same_v<KeyType, hash_t> && Comparator::SHIFT == 0 ? KeySearchKind::Integral
+                                                                : KeySearchKind::Normalized;
+};
+
+// Below this many candidates the branchless search hands over to a linear
+// count, which the AVX2 build vectorizes for integral keys.
+static constexpr int KEY_SEARCH_LINEAR_WINDOW = 8;
+
+#ifdef __AVX2__
+/**
+ * Counts the entries of keys[0, n) that are smaller than (or, with or_equal,
+ * not greater than) key. Unsigned order is emulated by flipping the sign bit.
+ */
+inline auto CountBeforeAvx2(const hash_t *keys, int n, hash_t key,
+                            bool or_equal) -> int {
+  const __m256i flip = _mm256_set1_epi64x(static_cast<long long>(1ULL << 63));
+  const __m256i probe = _mm256_xor_si256(
+      _mm256_set1_epi64x(static_cast<long long>(key)), flip);
+  int count = 0;
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    auto cur = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i)), flip);
+    auto mask = _mm256_cmpgt_epi64(probe, cur);
+    if (or_equal) {
+      mask = _mm256_or_si256(mask, _mm256_cmpeq_epi64(probe, cur));
+    }
+    count += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(mask)));
+  }
+  for (; i < n; ++i) {
+    count += or_equal ? keys[i] <= key : keys[i] < key;
+  }
+  return count;
+}
+#endif
+
+/**
+ * @brief Returns the first index in [begin, end) whose entry does not satisfy
+ * `before`, assuming the entries satisfying it form a prefix of the range.
+ *
+ * The loop body compiles to a conditional move, so the search takes the same
+ * path for every probe key.
+ */
+template <typename KeyType, typename Predicate>
+inline auto BranchlessPartition(const KeyType *keys, int begin, int end,
+                                Predicate before) -> int {
+  const KeyType *base = keys + begin;
+  int len = end - begin;
+  while (len > KEY_SEARCH_LINEAR_WINDOW) {
+    int half = len / 2;
+    base = before(base[half - 1]) ? base + half : base;
+    len -= half;
+  }
+  int count = 0;
+  for (int i = 0; i < len; ++i) {
+    count += before(base[i]) ? 1 : 0;
+  }
+  return static_cast<int>(base - keys) + count;
+}
+
+/**
+ * @brief Shared implementation of KeyLowerBound / KeyUpperBound.
+ *
+ * @param or_equal false for lower bound (first entry >= key), true for upper
+ * bound (first entry > key)
+ */
+template <typename KeyType, typename Comparator>
+inline auto KeyBound(const KeyType *keys, int begin, int end,
+                     const KeyType &key, const Comparator &comparator,
+                     bool or_equal) -> int {
+  constexpr auto kind = KeySearchTraits<KeyType, Comparator>::kind;
+  if constexpr (kind == KeySearchKind::Integral) {
+#ifdef __AVX2__
+    const KeyType *base = keys + begin;
+    int len = end - begin;
+    while (len > KEY_SEARCH_LINEAR_WINDOW) {
+      int half = len / 2;
+      bool before = or_equal ? base[half - 1] <= key : base[half - 1] < key;
+      base = before ? base + half : base;
+      len -= half;
+    }
+    return static_cast<int>(base - keys) +
+           CountBeforeAvx2(base, len, key, or_equal);
+#else
+    return BranchlessPartition(keys, begin, end, [&](const KeyType &cur) {
+      return or_equal ? cur <= key : cur < key;
+    });
+#endif
+  } else if constexpr (kind == KeySearchKind::Normalized) {
+    auto probe = Comparator::Prefix(key);
+    return BranchlessPartition(keys, begin, end, [&](const KeyType &cur) {
+      auto prefix = Comparator::Prefix(cur);
+      return or_equal ? prefix <= probe : prefix < probe;
+    });
+  } else {
+    int low = begin;
+    int high = end;
+    while (low < high) {
+      int mid = low + (high - low) / 2;
+      int flag = comparator(keys[mid], key);
+      if (flag < 0 || (or_equal && flag == 0)) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    return low;
+  }
+}
+
+/**
+ * @return the first index in [begin, end) whose key is not less than `key`
+ */
+template <typename KeyType, typename Comparator>
+inline auto KeyLowerBound(const KeyType *keys, int begin, int end,
+                          const KeyType &key, const Comparator &comparator)
+    -> int {
+  return KeyBound(keys, begin, end, key, comparator, false);
+}
+
+/**
+ * @return the first index in [begin, end) whose key is greater than `key`
+ */
+template <typename KeyType, typename Comparator>
+inline auto KeyUpperBound(const KeyType *keys, int begin, int end,
+                          const KeyType &key, const Comparator &comparator)
+    -> int {
+  return KeyBound(keys, begin, end, key, comparator, true);
+}
+}  // namespace sjtu
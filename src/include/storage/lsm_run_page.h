@@ -0,0 +1,89 @@
+#pragma once
+
+#include "common/config.h"
+
+namespace sjtu {
+  /**
+   * Page 1 of the manifest file of an LsmTree, listing the runs of every
+   * level by id. Level 0 holds up to LSM_L0_RUN_LIMIT runs, newest first,
+   * every deeper level at most one.
+   */
+  class LsmManifestPage {
+  public:
+    // Delete all constructor / destructor to ensure memory safety
+    LsmManifestPage() = delete;
+
+    LsmManifestPage(const LsmManifestPage &other) = delete;
+
+    // Zero in a fresh file.
+    int initialized_;
+
+    int next_run_id_;
+
+    int run_cnt_[LSM_MAX_LEVELS];
+
+    int run_ids_[LSM_MAX_LEVELS][LSM_L0_RUN_LIMIT];
+  };
+
+  /**
+   * Page 1 of a run file.
+   *
+   * Run file format (in pages):
+   *  ----------------------------------------------------------
+   * | HEADER | DATA(0) | ... | DATA(n - 1) | FENCE(0) | ...    |
+   *  ----------------------------------------------------------
+   *
+   * Data pages hold the entries in key order. The fence pages hold the first
+   * key of every data page followed by the last key of the run, so a lookup
+   * reads one data page per run at most.
+   */
+  class LsmRunHeaderPage {
+  public:
+    // Delete all constructor / destructor to ensure memory safety
+    LsmRunHeaderPage() = delete;
+
+    LsmRunHeaderPage(const LsmRunHeaderPage &other) = delete;
+
+    int entry_cnt_;
+
+    int tombstone_cnt_;
+
+    int data_page_cnt_;
+
+    int fence_page_cnt_;
+  };
+
+  // A value, or the tombstone of a removed key shadowing older runs.
+  template <typename KeyType, typename ValueType>
+  struct LsmEntry {
+    KeyType key_;
+    ValueType value_;
+    int tombstone_;
+  };
+
+  /**
+   * Data page of a run, a sorted array of entries.
+   *
+   *  ------------------------------------------------
+   * | Size (4) | padding | ENTRY(0) | ENTRY(1) | ... |
+   *  ------------------------------------------------
+   */
+  template <typename KeyType, typename ValueType>
+  class LsmRunPage {
+    using Entry = LsmEntry<KeyType, ValueType>;
+
+  public:
+    // Delete all constructor / destructor to ensure memory safety
+    LsmRunPage() = delete;
+
+    LsmRunPage(const LsmRunPage &other) = delete;
+
+    static constexpr int SLOT_CNT =
+        (SJTU_PAGE_SIZE - static_cast<int>(alignof(Entry) > 4 ? alignof(Entry) : 4)) /
+        static_cast<int>(sizeof(Entry));
+
+    int size_;
+
+    Entry entries_[SLOT_CNT];
+  };
+} // namespace sjtu
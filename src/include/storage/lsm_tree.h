@@ -0,0 +1,352 @@
+/**
+ * lsm_tree.h
+ *
+ * Write-optimized index with the point and prefix interface of BPlusTree.
+ * Writes go to a sorted in-memory memtable, which is flushed into an
+ * immutable sorted run once it is full. Runs are organized in levels and
+ * merged into the next level when a level gets too large, so the disk only
+ * ever sees sequential writes of whole runs.
+ *
+ * (1) We only support unique key, removes write tombstones
+ * (2) Every run lives in its own file, name + "_" + run id, listed by the
+ *     manifest file name
+ * (3) Fence pointers (the first key of every data page) stay in memory, a
+ *     point lookup reads at most one page per run
+ */
+#pragma once
+
+#include <iostream>
+#include <optional>
+#include <string>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/config.h"
+#include "common/vector.h"
+#include "storage/b_plus_tree_page.h"
+#include "storage/lsm_run_page.h"
+#include "storage/page_guard.h"
+
+namespace sjtu {
+#define LSMTREE_TYPE LsmTree<KeyType, ValueType, KeyComparator, DegradedKeyComparator>
+
+  /**
+   * Shape and health of an LSM tree, collected by LsmTree::Stats in one pass
+   * over every run.
+   */
+  struct LsmTreeStats {
+    // Runs and the entries (tombstones included) they hold per level.
+    sjtu::vector<int> level_runs_;
+    sjtu::vector<long long> level_entries_;
+    long long memtable_entry_cnt_{0};
+    long long tombstone_cnt_{0};
+    // Entries not strictly greater than the one before them in their run, and
+    // runs whose entry count or fence pointers disagree with their pages.
+    int order_violation_cnt_{0};
+    int structure_violation_cnt_{0};
+
+    auto IsHealthy() const -> bool {
+      return order_violation_cnt_ == 0 && structure_violation_cnt_ == 0;
+    }
+
+    void Print(std::ostream &os, const std::string &name) const;
+  };
+
+  INDEX_TEMPLATE_ARGUMENTS
+  class LsmTree {
+    using Entry = LsmEntry<KeyType, ValueType>;
+    using RunPage = LsmRunPage<KeyType, ValueType>;
+
+    // Entries are written to run pages as raw bytes.
+    static_assert(IsPageCopyable<KeyType>::value, "lsm keys must be trivially copyable");
+    static_assert(IsPageCopyable<ValueType>::value, "lsm values must be trivially copyable");
+
+    // Fence keys per fence page.
+    static constexpr int FENCE_CNT = SJTU_PAGE_SIZE / static_cast<int>(sizeof(KeyType));
+
+    /**
+     * An immutable run, open for as long as it is part of the tree. Data page
+     * i of the run is page i + 2 of its file.
+     */
+    struct Run {
+      int id_{0};
+      BufferPoolManager *bpm_{nullptr};
+      int entry_cnt_{0};
+      int tombstone_cnt_{0};
+      // First key of every data page, then the last key of the run.
+      sjtu::vector<KeyType> fences_;
+    };
+
+    /**
+     * Position in the memtable (run_ == nullptr) or in a run, holding the
+     * read guard of the current data page of a run.
+     */
+    struct Cursor {
+      const Run *run_{nullptr};
+      int page_{0};
+      int index_{0};
+      std::optional<ReadPageGuard> guard_;
+    };
+
+    // The memtable and every run.
+    static constexpr int MAX_SOURCE_CNT = 1 + LSM_L0_RUN_LIMIT + LSM_MAX_LEVELS - 1;
+
+  public:
+    /**
+     * @param name manifest file name
+     * @param memtable_size entries buffered in memory before they are flushed
+     */
+    explicit LsmTree(std::string name, const KeyComparator &comparator,
+                     const DegradedKeyComparator &degraded_comparator,
+                     int memtable_size = LSM_MEMTABLE_SIZE);
+
+    // Flushes the memtable, so nothing is lost on a clean shutdown.
+    ~LsmTree();
+
+    // Insert a key-value pair, false if the key is already stored.
+    auto Insert(const KeyType &key, const ValueType &value) -> bool;
+
+    /**
+     * Insert a key-value pair, shadowing any stored value of key. Never reads
+     * the runs, so it costs no I/O until the memtable is flushed.
+     *
+     * @return always true, whether the key existed is not checked
+     */
+    auto Upsert(const KeyType &key, const ValueType &value) -> bool;
+
+    // Remove a key and its value by writing a tombstone, without reading.
+    void Remove(const KeyType &key);
+
+    // Return the only value that associated with input key
+    auto GetValue(const KeyType &key, sjtu::vector<ValueType> *result) -> bool;
+
+    auto GetAllValue(const KeyType &key, sjtu::vector<ValueType> *result) -> bool;
+
+    /**
+     * @brief Visit every entry whose key matches prefix under the degraded
+     * comparator, in key order
+     *
+     * Same contract as BPlusTree::Scan, the newest version of every key is
+     * visited and removed keys are skipped.
+     *
+     * @return number of entries visited
+     */
+    template <typename Visitor>
+    auto Scan(const KeyType &prefix, Visitor &&visitor) -> int;
+
+    // Flush the memtable into level 0, merging levels that got too large.
+    void Flush();
+
+    // Merge every run and the memtable into one run, dropping tombstones.
+    void Compact();
+
+    // Shape of the levels, checking every run for order and structure.
+    auto Stats() -> LsmTreeStats;
+
+  private:
+    auto RunFileName(int run_id) const -> std::string;
+
+    // Open the run file of run_id and load its fence pointers.
+    auto OpenRun(int run_id) -> Run;
+
+    // Close run, and remove its file if drop.
+    void CloseRun(Run *run, bool drop);
+
+    /**
+     * @brief Write a new run file
+     *
+     * `produce(emit)` must call `emit(const Entry &)` for every entry of the
+     * run in key order.
+     */
+    template <typename Producer>
+    auto WriteRun(Producer &&produce) -> Run;
+
+    // Merge the runs of levels [first_level, last_level] into one run that
+    // replaces the run of last_level.
+    void MergeLevels(int first_level, int last_level);
+
+    // Entries a level may hold before it is merged into the next one.
+    auto LevelCapacity(int level) const -> long long;
+
+    void SaveManifest();
+
+    // Index of the first memtable entry not less than key under cmp.
+    template <typename Comparator>
+    auto MemtableLowerBound(const KeyType &key, const Comparator &cmp) const -> int;
+
+    // Data page of run that may hold key under cmp: the last one whose first
+    // key is less than key, or -1 if key is beyond the run.
+    template <typename Comparator>
+    auto FindRunPage(const Run &run, const KeyType &key, const Comparator &cmp) const -> int;
+
+    // Position cursor on the first entry not less than key under cmp.
+    template <typename Comparator>
+    void Seek(Cursor *cursor, const KeyType &key, const Comparator &cmp);
+
+    auto CursorEntry(const Cursor &cursor) const -> const Entry &;
+
+    auto CursorAtEnd(const Cursor &cursor) const -> bool;
+
+    void Advance(Cursor *cursor);
+
+    /**
+     * @brief Visit the newest version of every key of the cursors in key
+     * order, tombstones included
+     *
+     * cursors must be ordered newest source first. `visitor(const Entry &)`
+     * returns false to stop.
+     */
+    template <typename Visitor>
+    void MergeCursors(Cursor *cursors, int cursor_cnt, Visitor &&visitor);
+
+    // Cursors of the memtable and every run, newest first, at key under cmp.
+    template <typename Comparator>
+    auto SeekAll(Cursor *cursors, const KeyType &key, const Comparator &cmp) -> int;
+
+    std::string index_name_;
+    BufferPoolManager *bpm_;
+    KeyComparator comparator_;
+    DegradedKeyComparator degraded_comparator_;
+    int memtable_size_;
+    page_id_t manifest_page_id_;
+    int next_run_id_{0};
+    // Sorted by key, one entry per key.
+    sjtu::vector<Entry> memtable_;
+    // Level 0 newest run first, every deeper level at most one run.
+    sjtu::vector<Run> levels_[LSM_MAX_LEVELS];
+  };
+
+  INDEX_TEMPLATE_ARGUMENTS
+  template <typename Comparator>
+  auto LSMTREE_TYPE::MemtableLowerBound(const KeyType &key, const Comparator &cmp) const -> int {
+    int left = 0;
+    int right = memtable_.size();
+    while (left < right) {
+      int mid = (left + right) / 2;
+      if (cmp(memtable_[mid].key_, key) < 0) {
+        left = mid + 1;
+      } else {
+        right = mid;
+      }
+    }
+    return left;
+  }
+
+  INDEX_TEMPLATE_ARGUMENTS
+  template <typename Comparator>
+  auto LSMTREE_TYPE::FindRunPage(const Run &run, const KeyType &key, const Comparator &cmp) const
+    -> int {
+    int page_cnt = static_cast<int>(run.fences_.size()) - 1;
+    if (page_cnt <= 0 || cmp(run.fences_[page_cnt], key) < 0) {
+      return -1;
+    }
+    // last page whose first key is less than key, its successors start at or
+    // after key
+    int left = 0;
+    int right = page_cnt;
+    while (right - left > 1) {
+      int mid = (left + right) / 2;
+      if (cmp(run.fences_[mid], key) < 0) {
+        left = mid;
+      } else {
+        right = mid;
+      }
+    }
+    return left;
+  }
+
+  INDEX_TEMPLATE_ARGUMENTS
+  template <typename Comparator>
+  void LSMTREE_TYPE::Seek(Cursor *cursor, const KeyType &key, const Comparator &cmp) {
+    if (cursor->run_ == nullptr) {
+      cursor->index_ = MemtableLowerBound(key, cmp);
+      return;
+    }
+    auto page = FindRunPage(*cursor->run_, key, cmp);
+    if (page < 0) {
+      cursor->page_ = static_cast<int>(cursor->run_->fences_.size()) - 1;
+      cursor->guard_.reset();
+      return;
+    }
+    cursor->page_ = page;
+    cursor->guard_ = cursor->run_->bpm_->ReadPage(page + 2);
+    auto run_page = cursor->guard_->template As<RunPage>();
+    int left = 0;
+    int right = run_page->size_;
+    while (left < right) {
+      int mid = (left + right) / 2;
+      if (cmp(run_page->entries_[mid].key_, key) < 0) {
+        left = mid + 1;
+      } else {
+        right = mid;
+      }
+    }
+    cursor->index_ = left;
+    if (left == run_page->size_) {
+      Advance(cursor);
+    }
+  }
+
+  INDEX_TEMPLATE_ARGUMENTS
+  template <typename Comparator>
+  auto LSMTREE_TYPE::SeekAll(Cursor *cursors, const KeyType &key, const Comparator &cmp) -> int {
+    int cursor_cnt = 0;
+    Seek(&cursors[cursor_cnt++], key, cmp);
+    for (int level = 0; level < LSM_MAX_LEVELS; ++level) {
+      for (int i = 0; i < levels_[level].size(); ++i) {
+        cursors[cursor_cnt].run_ = &levels_[level][i];
+        Seek(&cursors[cursor_cnt++], key, cmp);
+      }
+    }
+    return cursor_cnt;
+  }
+
+  INDEX_TEMPLATE_ARGUMENTS
+  template <typename Visitor>
+  void LSMTREE_TYPE::MergeCursors(Cursor *cursors, int cursor_cnt, Visitor &&visitor) {
+    while (true) {
+      int newest = -1;
+      for (int i = 0; i < cursor_cnt; ++i) {
+        if (CursorAtEnd(cursors[i])) {
+          continue;
+        }
+        if (newest < 0 ||
+            comparator_(CursorEntry(cursors[i]).key_, CursorEntry(cursors[newest]).key_) < 0) {
+          newest = i;
+        }
+      }
+      if (newest < 0) {
+        return;
+      }
+      // older versions of the key are skipped
+      const Entry entry = CursorEntry(cursors[newest]);
+      for (int i = newest + 1; i < cursor_cnt; ++i) {
+        if (!CursorAtEnd(cursors[i]) && comparator_(CursorEntry(cursors[i]).key_, entry.key_) == 0) {
+          Advance(&cursors[i]);
+        }
+      }
+      Advance(&cursors[newest]);
+      if (!visitor(entry)) {
+        return;
+      }
+    }
+  }
+
+  INDEX_TEMPLATE_ARGUMENTS
+  template <typename Visitor>
+  auto LSMTREE_TYPE::Scan(const KeyType &prefix, Visitor &&visitor) -> int {
+    Cursor cursors[MAX_SOURCE_CNT];
+    int cursor_cnt = SeekAll(cursors, prefix, degraded_comparator_);
+    int count = 0;
+    MergeCursors(cursors, cursor_cnt, [&](const Entry &entry) {
+      if (degraded_comparator_(prefix, entry.key_) != 0) {
+        return false;
+      }
+      if (entry.tombstone_ != 0) {
+        return true;
+      }
+      ++count;
+      return static_cast<bool>(visitor(entry.key_, entry.value_));
+    });
+    return count;
+  }
+} // namespace sjtu
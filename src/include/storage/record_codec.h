@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace sjtu {
+/**
+ * Serialization of leaf values.
+ *
+ * The primary template leaves a value type fixed-width: leaf pages keep such
+ * values in a plain array and hand out references into the page.
+ *
+ * A specialization with VARIABLE_LENGTH = true switches the leaf pages of
+ * that value type to the slotted layout, where every value is stored in its
+ * encoded form only. It must provide
+ *
+ *   static constexpr int MIN_SIZE / MAX_SIZE;  bounds of Size()
+ *   static auto Size(const T &value) -> int;   encoded length in bytes
+ *   static void Encode(const T &value, char *dst);
+ *   static auto Decode(const char *src) -> T;
+ *
+ * The encoded length of a value should only change when the value is
+ * rewritten as a whole, since in-place updates that grow a record may have
+ * to split its leaf.
+ */
+template <typename T>
+struct RecordCodec {
+  static constexpr bool VARIABLE_LENGTH = false;
+};
+
+// Appends fields to an encoding buffer.
+class RecordWriter {
+ public:
+  explicit RecordWriter(char *dst) : cur_(dst) {}
+
+  template <typename T>
+  void Put(const T &field) {
+    memcpy(cur_, &field, sizeof(T));
+    cur_ += sizeof(T);
+  }
+
+  // Writes the NUL-terminated prefix of str[0, cap) behind a length byte.
+  void PutString(const char *str, int cap) {
+    auto len = static_cast<uint8_t>(strnlen(str, cap));
+    *cur_++ = static_cast<char>(len);
+    memcpy(cur_, str, len);
+    cur_ += len;
+  }
+
+  // Encoded length of the string PutString writes.
+  static auto StringSize(const char *str, int cap) -> int {
+    return 1 + static_cast<int>(strnlen(str, cap));
+  }
+
+ private:
+  char *cur_;
+};
+
+// Reads back the fields written by RecordWriter, in the same order.
+class RecordReader {
+ public:
+  explicit RecordReader(const char *src) : cur_(src) {}
+
+  template <typename T>
+  void Get(T *field) {
+    memcpy(field, cur_, sizeof(T));
+    cur_ += sizeof(T);
+  }
+
+  // Reads a string into dst, which must hold the length plus the terminator.
+  void GetString(char *dst) {
+    auto len = static_cast<uint8_t>(*cur_++);
+    memcpy(dst, cur_, len);
+    dst[len] = '\0';
+    cur_ += len;
+  }
+
+ private:
+  const char *cur_;
+};
+}  // namespace sjtu
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "storage/b_plus_tree.h"
+#include "storage/lsm_tree.h"
+
+namespace sjtu {
+  /**
+   * Storage engine of a SelectableIndex.
+   *
+   * BPlusTree - updates pages in place, best for read-mostly indexes.
+   * Lsm       - buffers writes and appends them as sorted runs, best for
+   *             indexes that are mostly written, see LsmTree.
+   */
+  enum class IndexEngine { BPlusTree, Lsm };
+
+  /**
+   * An index whose engine is picked when it is opened. Offers the part of the
+   * interface both engines share, with the semantics of BPlusTree.
+   *
+   * The engines keep separate files: a B+ tree uses name, an LSM tree the
+   * manifest name + "_lsm" and its runs next to it.
+   */
+  INDEX_TEMPLATE_ARGUMENTS
+  class SelectableIndex {
+  public:
+    SelectableIndex(IndexEngine engine, const std::string &name, const KeyComparator &comparator,
+                    const DegradedKeyComparator &degraded_comparator,
+                    int bpm_max_size = BUFFER_POOL_SIZE) {
+      if (engine == IndexEngine::Lsm) {
+        lsm_ = std::make_unique<LsmTree<KeyType, ValueType, KeyComparator, DegradedKeyComparator> >(
+            name + "_lsm", comparator, degraded_comparator);
+      } else {
+        btree_ = std::make_unique<BPlusTree<KeyType, ValueType, KeyComparator, DegradedKeyComparator> >(
+            name, comparator, degraded_comparator, bpm_max_size);
+      }
+    }
+
+    // Only B+ trees rebalance, LSM runs are never underfull.
+    void SetUnderflowPolicy(UnderflowPolicy policy) {
+      if (btree_ != nullptr) {
+        btree_->SetUnderflowPolicy(policy);
+      }
+    }
+
+    auto Insert(const KeyType &key, const ValueType &value) -> bool {
+      return btree_ != nullptr ? btree_->Insert(key, value) : lsm_->Insert(key, value);
+    }
+
+    // An LSM tree writes blindly and always returns true, see LsmTree::Upsert.
+    auto Upsert(const KeyType &key, const ValueType &value) -> bool {
+      return btree_ != nullptr ? btree_->Upsert(key, value) : lsm_->Upsert(key, value);
+    }
+
+    void Remove(const KeyType &key) {
+      if (btree_ != nullptr) {
+        btree_->Remove(key);
+      } else {
+        lsm_->Remove(key);
+      }
+    }
+
+    auto GetValue(const KeyType &key, sjtu::vector<ValueType> *result) -> bool {
+      return btree_ != nullptr ? btree_->GetValue(key, result) : lsm_->GetValue(key, result);
+    }
+
+    template <typename Visitor>
+    auto Scan(const KeyType &prefix, Visitor &&visitor) -> int {
+      if (btree_ != nullptr) {
+        return btree_->Scan(prefix, std::forward<Visitor>(visitor));
+      }
+      return lsm_->Scan(prefix, std::forward<Visitor>(visitor));
+    }
+
+    void Compact() {
+      if (btree_ != nullptr) {
+        btree_->Compact();
+      } else {
+        lsm_->Compact();
+      }
+    }
+
+    // Print the Stats of the engine as one line.
+    void PrintStats(std::ostream &os, const std::string &name) {
+      if (btree_ != nullptr) {
+        btree_->Stats().Print(os, name);
+      } else {
+        lsm_->Stats().Print(os, name);
+      }
+    }
+
+  private:
+    std::unique_ptr<BPlusTree<KeyType, ValueType, KeyComparator, DegradedKeyComparator> > btree_;
+    std::unique_ptr<LsmTree<KeyType, ValueType, KeyComparator, DegradedKeyComparator> > lsm_;
+  };
+} // namespace sjtu
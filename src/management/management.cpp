@@ -3,13 +3,17 @@
 namespace sjtu {
 Management::Management(std::string name) {
   user_ = new User(name);
-  ticket_ = new Ticket(name, user_);
+  stations_ = new StationDict(name);
+  catalog_ = new TrainCatalog(name);
+  ticket_ = new Ticket(name, user_, stations_, catalog_);
   train_ = new Train(name, ticket_);
 }
 
 Management::~Management() {
   delete train_;
   delete ticket_;
+  delete catalog_;
+  delete stations_;
   delete user_;
 }
 
@@ -108,8 +112,8 @@ bool Management::ProcessLine(vector<std::string> &line) {
     std::cout << "bye";
     return false;
   } else if (cmd == "add_train") {
-    TrainInfo train_info(i, n, m, s, p, x, t, o, d, y);
-    train_->AddTrain(train_info);
+    TrainInfo train_info(i, n, m, p, x, t, o, d, y);
+    train_->AddTrain(train_info, s);
   } else if (cmd == "delete_train") {
     train_->DeleteTrain(i);
   } else if (cmd == "release_train") {
@@ -144,6 +148,12 @@ bool Management::ProcessLine(vector<std::string> &line) {
     } else {
       ticket_->QueryTransfer(train_, s, t, DateToNum(d), p);
     }
+  } else if (cmd == "inspect_db") {
+    // not part of the protocol, for checking the indexes of a live system
+    ticket_->Inspect();
+  } else if (cmd == "compact_db") {
+    ticket_->Compact();
+    std::cout << "0\n";
   } else if (cmd == "clean") {
     Clean("ticket_system");
     std::cout << "0\n";
@@ -154,16 +164,24 @@ bool Management::ProcessLine(vector<std::string> &line) {
 void Management::Clean(std::string name) {
   delete train_;
   delete ticket_;
+  delete catalog_;
+  delete stations_;
   delete user_;
   std::filesystem::remove("ticket_system_db");
   std::filesystem::remove("ticket_system_order_db");
   std::filesystem::remove("ticket_system_pending_db");
   std::filesystem::remove("ticket_system_station_db");
+  std::filesystem::remove("ticket_system_station_dict");
+  std::filesystem::remove("ticket_system_station_names");
   std::filesystem::remove("ticket_system_ticket_db");
-  std::filesystem::remove("train_db");
+  std::filesystem::remove("ticket_system_ticket_db_heap");
+  std::filesystem::remove("ticket_system_train_ids");
+  std::filesystem::remove("ticket_system_train_catalog");
   std::filesystem::remove("train_manager");
   user_ = new User(name);
-  ticket_ = new Ticket(name, user_);
+  stations_ = new StationDict(name);
+  catalog_ = new TrainCatalog(name);
+  ticket_ = new Ticket(name, user_, stations_, catalog_);
   train_ = new Train(name, ticket_);
 }
 
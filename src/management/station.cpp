@@ -0,0 +1,59 @@
+#include "management/station.h"
+
+#include <cstring>
+
+namespace sjtu {
+StationDict::StationDict(const std::string &name) {
+  HashComp comp;
+  id_db_ = std::make_unique<ExtendibleHashTable<hash_t, station_t, HashComp> >(
+      name + "_station_dict", comp, 64);
+  name_manager_ =
+      std::make_unique<BufferPoolManager>(64, name + "_station_names");
+  header_page_id_ = name_manager_->NewPage();
+  auto guard = name_manager_->WritePage(header_page_id_);
+  auto header_page = guard.AsMut<StationDictHeaderPage>();
+  if (header_page->next_page_id_ != 0) {
+    name_manager_->SetNextPageId(header_page->next_page_id_);
+  }
+  station_cnt_ = header_page->station_cnt_;
+}
+
+StationDict::~StationDict() {
+  auto guard = name_manager_->WritePage(header_page_id_);
+  auto header_page = guard.AsMut<StationDictHeaderPage>();
+  header_page->next_page_id_ = name_manager_->GetNextPageId();
+  header_page->station_cnt_ = station_cnt_;
+}
+
+auto StationDict::Intern(const std::string &name) -> station_t {
+  auto hash = ToHash(name.c_str());
+  vector<station_t> id_vector;
+  if (id_db_->GetValue(hash, &id_vector)) {
+    return id_vector[0];
+  }
+  auto id = station_cnt_++;
+  if (id % StationNamePage::SLOT_CNT == 0) {
+    name_manager_->NewPage();
+  }
+  auto guard = name_manager_->WritePage(header_page_id_ + 1 +
+                                        id / StationNamePage::SLOT_CNT);
+  strncpy(guard.AsMut<StationNamePage>()->names_[id % StationNamePage::SLOT_CNT],
+          name.c_str(), STATION_NAME_SIZE);
+  id_db_->Insert(hash, id);
+  return id;
+}
+
+auto StationDict::Find(std::string &name) -> station_t {
+  vector<station_t> id_vector;
+  if (!id_db_->GetValue(ToHash(name), &id_vector)) {
+    return INVALID_STATION_ID;
+  }
+  return id_vector[0];
+}
+
+auto StationDict::Name(station_t id) -> std::string {
+  auto guard = name_manager_->ReadPage(header_page_id_ + 1 +
+                                       id / StationNamePage::SLOT_CNT);
+  return guard.As<StationNamePage>()->names_[id % StationNamePage::SLOT_CNT];
+}
+}  // namespace sjtu
@@ -9,7 +9,9 @@ namespace sjtu {
 struct SortByCost;
 struct SortByTime;
 
-Ticket::Ticket(std::string &name, User *user) : user_(user) {
+Ticket::Ticket(std::string &name, User *user, StationDict *stations,
+               TrainCatalog *catalog, IndexEngine pending_engine)
+    : user_(user), stations_(stations), catalog_(catalog) {
   HashComp hashcomp;
   PairCompare<TrainDate> tdcomp;
   PairDegradedCompare<TrainDate> tdcomp_d;
@@ -20,77 +22,95 @@ Ticket::Ticket(std::string &name, User *user) : user_(user) {
   TDOCompare tdocomp;
   TDODegradedCompare tdocomp_d;
   ticket_db_ = std::make_unique<
-      BPlusTree<TrainDate, TicketDateInfo, PairCompare<TrainDate>,
-                PairDegradedCompare<TrainDate> > >(name + "_ticket_db", tdcomp,
-                                                   tdcomp_d, 256);
-  order_db_ =
-      std::make_unique<BPlusTree<OrderTime, OrderInfo, PairCompare<OrderTime>,
-                                 PairDegradedCompare<OrderTime> > >(
-          name + "_order_db", odcomp, odcomp_d, 256);
-  pending_db_ = std::make_unique<
-      BPlusTree<TrainDateOrder, PendingInfo, TDOCompare, TDODegradedCompare> >(
-      name + "_pending_db", tdocomp, tdocomp_d, 256);
+      HeapBPlusTree<TrainDate, TicketDateInfo, PairCompare<TrainDate>,
+                    PairDegradedCompare<TrainDate> > >(name + "_ticket_db",
+                                                       tdcomp, tdcomp_d, 256);
+  // counted, so order totals and the n-th newest order take one descent
+  using OrderTree = BPlusTree<OrderTime, OrderInfo, PairCompare<OrderTime>,
+                              PairDegradedCompare<OrderTime> >;
+  order_db_ = std::make_unique<OrderTree>(
+      name + "_order_db", odcomp, odcomp_d, 256, OrderTree::LEAF_MAX_SIZE,
+      OrderTree::INTERNAL_MAX_SIZE, true);
+  pending_db_ = std::make_unique<SelectableIndex<
+      TrainDateOrder, PendingInfo, TDOCompare, TDODegradedCompare> >(
+      pending_engine, name + "_pending_db", tdocomp, tdocomp_d, 256);
+  // pending orders come and go all the time, keep their leaves from
+  // thrashing between merges and splits
+  pending_db_->SetUnderflowPolicy(UnderflowPolicy::Lazy);
   station_db_ = std::make_unique<
       BPlusTree<StationTrain, StationTrainInfo, PairCompare<StationTrain>,
                 PairDegradedCompare<StationTrain> > >(name + "_station_db",
                                                       stcomp, stcomp_d, 256);
+  // buy_ticket looks up (station, train) pairs that often do not exist
+  station_db_->EnableBloomFilter();
 }
 
 void Ticket::QueryTicket(std::string &from, std::string &to, num_t date,
                          std::string comp) {
-  auto from_hash = ToHash(from);
-  auto to_hash = ToHash(to);
-  vector<StationTrainInfo> from_vector, to_vector;
-  station_db_->GetAllValue(StationTrain(from_hash, 0), &from_vector);
-  station_db_->GetAllValue(StationTrain(to_hash, 0), &to_vector);
-  if (from_vector.empty() || to_vector.empty()) {
+  auto from_id = stations_->Find(from);
+  auto to_id = stations_->Find(to);
+  if (from_id == INVALID_STATION_ID || to_id == INVALID_STATION_ID) {
     std::cout << "0\n";
     return;
   }
-  map<hash_t, int> train_map;
-  int vec_size = from_vector.size();
-  for (int i = 0; i < vec_size; ++i) {
-    auto early_date =
-        from_vector[i].saleDate.first + from_vector[i].arrivingTime.date;
-    auto late_date =
-        from_vector[i].saleDate.second + from_vector[i].leavingTime.date;
+  // only the trains leaving `from` on `date` are kept, and only the fields
+  // the ticket needs
+  map<train_t, StationTrainInfo> train_map;
+  station_db_->Scan(StationTrain(from_id, 0), [&](const StationTrain &key,
+                                                  const StationTrainInfo &info) {
+    auto early_date = info.saleDate.first + info.arrivingTime.date;
+    auto late_date = info.saleDate.second + info.leavingTime.date;
     if (early_date <= date && date <= late_date) {
-      train_map.insert(from_vector[i].trainID_hash, i);
+      train_map.insert(key.second, info);
     }
-  }
+    return true;
+  });
+  auto for_each_ticket = [&](auto &&emit) {
+    if (train_map.empty()) {
+      return;
+    }
+    // the seats of all trains are read in one batch once they are known
+    vector<TicketComp> tickets;
+    vector<TrainDate> ticket_keys;
+    station_db_->Scan(
+        StationTrain(to_id, 0),
+        [&](const StationTrain &key, const StationTrainInfo &train) {
+          auto it = train_map.find(key.second);
+          if (it == train_map.end()) {
+            return true;
+          }
+          auto &from_leg = it->second;
+          if (from_leg.station_index >= train.station_index) {
+            return true;
+          }
+          if (date - from_leg.leavingTime.date < from_leg.saleDate.first) {
+            return true;
+          }
+          ticket_keys.push_back(
+              TrainDate(key.second, date - from_leg.leavingTime.date));
+          tickets.push_back(TicketComp(
+              train.arrivingTime - from_leg.leavingTime,
+              train.price - from_leg.price, 0, from_leg.station_index,
+              train.station_index,
+              DateTime(date, from_leg.leavingTime.time),
+              DateTime(date + train.arrivingTime.date -
+                           from_leg.leavingTime.date,
+                       train.arrivingTime.time),
+              key.second, catalog_->Meta(key.second).trainID));
+          return true;
+        });
+    vector<std::optional<TicketDateInfo> > ticketNum;
+    ticket_db_->MultiGet(ticket_keys, &ticketNum);
+    for (int i = 0; i < tickets.size(); ++i) {
+      tickets[i].ticket_num = ticketNum[i]->getSeat(tickets[i].station_index_1,
+                                                    tickets[i].station_index_2);
+      emit(tickets[i]);
+    }
+  };
 
   if (comp == "time") {
     sjtu::priority_queue<TicketComp, SortByTime> queue;
-
-    for (auto &train : to_vector) {
-      auto it = train_map.find(train.trainID_hash);
-      if (it != train_map.end()) {
-        if (from_vector[it->second].station_index >= train.station_index) {
-          continue;
-        }
-        vector<TicketDateInfo> ticketNum;
-        if (date - from_vector[it->second].leavingTime.date <
-            from_vector[it->second].saleDate.first) {
-          continue;
-        }
-        ticket_db_->GetValue(
-            TrainDate(train.trainID_hash,
-                      date - from_vector[it->second].leavingTime.date),
-            &ticketNum);
-        auto t_num = ticketNum[0].getSeat(from_vector[it->second].station_index,
-                                          train.station_index);
-        TicketComp ticket(
-            train.arrivingTime - from_vector[it->second].leavingTime,
-            train.price - from_vector[it->second].price, t_num,
-            from_vector[it->second].station_index, train.station_index,
-            DateTime(date, from_vector[it->second].leavingTime.time),
-            DateTime(date + train.arrivingTime.date -
-                         from_vector[it->second].leavingTime.date,
-                     train.arrivingTime.time),
-            train.trainID_hash, train.trainID);
-        queue.push(ticket);
-      }
-    }
+    for_each_ticket([&](TicketComp ticket) { queue.push(ticket); });
     std::cout << queue.size() << '\n';
     while (!queue.empty()) {
       auto ticket = queue.top();
@@ -101,36 +121,7 @@ void Ticket::QueryTicket(std::string &from, std::string &to, num_t date,
     }
   } else {
     sjtu::priority_queue<TicketComp, SortByCost> queue;
-    for (auto &train : to_vector) {
-      auto it = train_map.find(train.trainID_hash);
-      if (it != train_map.end()) {
-        if (from_vector[it->second].station_index >= train.station_index) {
-          continue;
-        }
-        vector<TicketDateInfo> ticketNum;
-        if (date - from_vector[it->second].leavingTime.date <
-            from_vector[it->second].saleDate.first) {
-          continue;
-        }
-        ticket_db_->GetValue(
-            TrainDate(train.trainID_hash,
-                      date - from_vector[it->second].leavingTime.date),
-            &ticketNum);
-
-        auto t_num = ticketNum[0].getSeat(from_vector[it->second].station_index,
-                                          train.station_index);
-        TicketComp ticket(
-            train.arrivingTime - from_vector[it->second].leavingTime,
-            train.price - from_vector[it->second].price, t_num,
-            from_vector[it->second].station_index, train.station_index,
-            DateTime(date, from_vector[it->second].leavingTime.time),
-            DateTime(date + train.arrivingTime.date -
-                         from_vector[it->second].leavingTime.date,
-                     train.arrivingTime.time),
-            train.trainID_hash, train.trainID);
-        queue.push(ticket);
-      }
-    }
+    for_each_ticket([&](TicketComp ticket) { queue.push(ticket); });
     std::cout << queue.size() << '\n';
     while (!queue.empty()) {
       auto ticket = queue.top();
@@ -146,221 +137,153 @@ void Ticket::QueryTicket(std::string &from, std::string &to, num_t date,
 // TODO::Fatial bug in date count in transfer and refund
 void Ticket::QueryTransfer(Train *train_system, std::string &from,
                            std::string &to, num_t date, std::string comp) {
-  auto from_hash = ToHash(from);
-  auto to_hash = ToHash(to);
-  vector<StationTrainInfo> from_vector, to_vector;
-  station_db_->GetAllValue(StationTrain(from_hash, 0), &from_vector);
-  station_db_->GetAllValue(StationTrain(to_hash, 0), &to_vector);
-  if (from_vector.empty() || to_vector.empty()) {
+  auto from_id = stations_->Find(from);
+  auto to_id = stations_->Find(to);
+  if (from_id == INVALID_STATION_ID || to_id == INVALID_STATION_ID) {
     std::cout << "0\n";
     return;
   }
-  map<hash_t, int> train_map;
-  int vec_size = to_vector.size();
-  for (int i = 0; i < vec_size; ++i) {
-    train_map.insert(to_vector[i].trainID_hash, i);
-  }
-  list<StationTrainInfo> train_list;
-  vec_size = from_vector.size();
-  for (int i = 0; i < vec_size; ++i) {
-    auto early_date =
-        from_vector[i].saleDate.first + from_vector[i].arrivingTime.date;
-    auto late_date =
-        from_vector[i].saleDate.second + from_vector[i].leavingTime.date;
-    if (early_date <= date && date <= late_date) {
-      train_list.push_back(from_vector[i]);
-    }
+  map<train_t, StationTrainInfo> train_map;
+  station_db_->Scan(StationTrain(to_id, 0), [&](const StationTrain &key,
+                                                const StationTrainInfo &info) {
+    train_map.insert(key.second, info);
+    return true;
+  });
+  list<std::pair<train_t, StationTrainInfo> > train_list;
+  if (!train_map.empty()) {
+    station_db_->Scan(StationTrain(from_id, 0), [&](const StationTrain &key,
+                                                    const StationTrainInfo &info) {
+      auto early_date = info.saleDate.first + info.arrivingTime.date;
+      auto late_date = info.saleDate.second + info.leavingTime.date;
+      if (early_date <= date && date <= late_date) {
+        train_list.push_back(std::make_pair(key.second, info));
+      }
+      return true;
+    });
   }
 
-  if (comp == "time") {
-    priority_queue<TicketTransComp, TranSortByTime> queue;
-    for (auto &train : train_list) {
-      vector<TrainMeta> train_meta;
-      train_system->train_db_->GetValue(train.trainID_hash, &train_meta);
-      auto trainInfo =
-          train_system->train_manager_->ReadPage(train_meta[0].page_id)
-              .As<TrainInfo>();
+  auto for_each_transfer = [&](auto &&emit) {
+    for (auto &leg : train_list) {
+      auto train_id = leg.first;
+      auto &train = leg.second;
+      auto train_guard = train_system->train_manager_->ReadPage(
+          catalog_->Meta(train_id).page_id);
+      auto trainInfo = train_guard.As<TrainInfo>();
 
-      auto leaveTime = DateTime(date, train.leavingTime.time);
-      auto arriveTime = leaveTime;
-
-      auto init_leaveTime = leaveTime;
-      int cost = 0;
+      auto init_leaveTime = DateTime(date, train.leavingTime.time);
+      auto from_offset = trainInfo->leavingOffsets[train.station_index];
+      auto from_price = trainInfo->prices[train.station_index];
 
       for (int i = train.station_index + 1; i < trainInfo->stationNum; ++i) {
-        auto station_hash = ToHash(trainInfo->stations[i]);
-        arriveTime = leaveTime;
-        arriveTime += trainInfo->travelTimes[i - 1];
-        leaveTime = arriveTime;
-        if (i != trainInfo->stationNum - 1) {
-          leaveTime += trainInfo->stopoverTimes[i - 1];
-        } else {
-          leaveTime.date += 100;
-        }
-        cost += trainInfo->prices[i - 1];
+        auto station = trainInfo->stations[i];
+        auto arriveTime =
+            DateTime(date, train.leavingTime.time +
+                               trainInfo->arrivingOffsets[i] - from_offset);
+        int cost = trainInfo->prices[i] - from_price;
 
-        vector<StationTrainInfo> trans_vector;
-        station_db_->GetAllValue(StationTrain(station_hash, 0), &trans_vector);
-        for (auto &trans : trans_vector) {
-          auto it = train_map.find(trans.trainID_hash);
-          if (it == train_map.end() ||
-              trans.trainID_hash == train.trainID_hash ||
-              trans.station_index >= to_vector[it->second].station_index) {
-            continue;
-          }
+        station_db_->Scan(
+            StationTrain(station, 0),
+            [&](const StationTrain &key, const StationTrainInfo &trans) {
+              auto it = train_map.find(key.second);
+              if (it == train_map.end() || key.second == train_id ||
+                  trans.station_index >= it->second.station_index) {
+                return true;
+              }
 
-          // now trans refers to a train that go from station[i] to Destination
-          // next we should check what days are available
-          // the only requirement is leavetime_2>=arrivetime_1
-          if (trans.saleDate.second + trans.leavingTime.date <
-              arriveTime.date) {
-            continue;
-          }
-          DateTime latetime(arriveTime.date, trans.leavingTime.time);
+              // now trans refers to a train that go from station[i] to
+              // Destination next we should check what days are available
+              // the only requirement is leavetime_2>=arrivetime_1
+              if (trans.saleDate.second + trans.leavingTime.date <
+                  arriveTime.date) {
+                return true;
+              }
+              DateTime latetime(arriveTime.date, trans.leavingTime.time);
 
-          if (latetime < arriveTime) {
-            latetime.date++;
-          }
-          if (latetime.date > trans.saleDate.second + trans.leavingTime.date) {
-            continue;
-          }
-          if (latetime.date < trans.saleDate.first + trans.leavingTime.date) {
-            latetime.date = trans.saleDate.first + trans.leavingTime.date;
-          }
+              if (latetime < arriveTime) {
+                latetime.date++;
+              }
+              if (latetime.date >
+                  trans.saleDate.second + trans.leavingTime.date) {
+                return true;
+              }
+              if (latetime.date <
+                  trans.saleDate.first + trans.leavingTime.date) {
+                latetime.date = trans.saleDate.first + trans.leavingTime.date;
+              }
 
-          auto &to_train = to_vector[it->second];
-          vector<TicketDateInfo> ticketNum_1, ticketNum_2;
-          ticket_db_->GetValue(
-              TrainDate(train.trainID_hash, date - train.leavingTime.date),
-              &ticketNum_1);
-          ticket_db_->GetValue(
-              TrainDate(trans.trainID_hash,
-                        latetime.date - trans.leavingTime.date),
-              &ticketNum_2);
-          auto t_num_1 = ticketNum_1[0].getSeat(train.station_index, i);
-          auto t_num_2 = ticketNum_2[0].getSeat(trans.station_index,
-                                                to_train.station_index);
-          TicketComp ticket_1(arriveTime - init_leaveTime, cost, t_num_1,
-                              train.station_index, i, init_leaveTime,
-                              arriveTime, train.trainID_hash, train.trainID);
-          TicketComp ticket_2(
-              to_train.arrivingTime - latetime, to_train.price - trans.price,
-              t_num_2, trans.station_index, to_train.station_index, latetime,
-              DateTime(latetime.date - trans.leavingTime.date +
-                           to_train.arrivingTime.date,
-                       to_train.arrivingTime.time),
-              trans.trainID_hash, trans.trainID);
-          TicketTransComp ticket(ticket_1, ticket_2, trainInfo->stations[i]);
-          queue.push(ticket);
-        }
+              auto &to_train = it->second;
+              TicketComp ticket_1(arriveTime - init_leaveTime, cost, 0,
+                                  train.station_index, i, init_leaveTime,
+                                  arriveTime, train_id, trainInfo->trainID);
+              TicketComp ticket_2(
+                  to_train.arrivingTime - latetime,
+                  to_train.price - trans.price, 0, trans.station_index,
+                  to_train.station_index, latetime,
+                  DateTime(latetime.date - trans.leavingTime.date +
+                               to_train.arrivingTime.date,
+                           to_train.arrivingTime.time),
+                  key.second, catalog_->Meta(key.second).trainID);
+              TicketTransComp transfer(ticket_1, ticket_2, station);
+              transfer.init_date_1 = date - train.leavingTime.date;
+              transfer.init_date_2 = latetime.date - trans.leavingTime.date;
+              emit(transfer);
+              return true;
+            });
       }
     }
+  };
+
+  // seats do not take part in the ranking, only the chosen transfer needs them
+  auto fill_seats = [&](TicketTransComp &ticket) {
+    vector<TrainDate> ticket_keys;
+    ticket_keys.push_back(
+        TrainDate(ticket.ticket_1.train, ticket.init_date_1));
+    ticket_keys.push_back(
+        TrainDate(ticket.ticket_2.train, ticket.init_date_2));
+    vector<std::optional<TicketDateInfo> > ticketNum;
+    ticket_db_->MultiGet(ticket_keys, &ticketNum);
+    ticket.ticket_1.ticket_num = ticketNum[0]->getSeat(
+        ticket.ticket_1.station_index_1, ticket.ticket_1.station_index_2);
+    ticket.ticket_2.ticket_num = ticketNum[1]->getSeat(
+        ticket.ticket_2.station_index_1, ticket.ticket_2.station_index_2);
+  };
+
+  if (comp == "time") {
+    priority_queue<TicketTransComp, TranSortByTime> queue;
+    for_each_transfer([&](TicketTransComp ticket) { queue.push(ticket); });
     if (queue.empty()) {
       std::cout << "0\n";
       return;
     } else {
       auto ticket = queue.top();
+      fill_seats(ticket);
+      auto station = stations_->Name(ticket.station);
       std::cout << ticket.ticket_1.trainID << ' ' << from << ' '
-                << ticket.ticket_1.leavingTime << " -> " << ticket.station
+                << ticket.ticket_1.leavingTime << " -> " << station
                 << ' ' << ticket.ticket_1.arrivingTime << ' '
                 << ticket.ticket_1.cost << ' ' << ticket.ticket_1.ticket_num
                 << '\n'
-                << ticket.ticket_2.trainID << ' ' << ticket.station << ' '
+                << ticket.ticket_2.trainID << ' ' << station << ' '
                 << ticket.ticket_2.leavingTime << " -> " << to << ' '
                 << ticket.ticket_2.arrivingTime << ' ' << ticket.ticket_2.cost
                 << ' ' << ticket.ticket_2.ticket_num << '\n';
     }
   } else {
     priority_queue<TicketTransComp, TranSortByCost> queue;
-    for (auto &train : train_list) {
-      vector<TrainMeta> train_meta;
-      train_system->train_db_->GetValue(train.trainID_hash, &train_meta);
-      auto trainInfo =
-          train_system->train_manager_->ReadPage(train_meta[0].page_id)
-              .As<TrainInfo>();
-
-      auto leaveTime = DateTime(date, train.leavingTime.time);
-      auto arriveTime = leaveTime;
-
-      auto init_leaveTime = leaveTime;
-      int cost = 0;
-
-      for (int i = train.station_index + 1; i < trainInfo->stationNum; ++i) {
-        auto station_hash = ToHash(trainInfo->stations[i]);
-        arriveTime = leaveTime;
-        arriveTime += trainInfo->travelTimes[i - 1];
-        leaveTime = arriveTime;
-        if (i != trainInfo->stationNum - 1) {
-          leaveTime += trainInfo->stopoverTimes[i - 1];
-        } else {
-          leaveTime.date += 100;
-        }
-        cost += trainInfo->prices[i - 1];
-
-        vector<StationTrainInfo> trans_vector;
-        station_db_->GetAllValue(StationTrain(station_hash, 0), &trans_vector);
-        for (auto &trans : trans_vector) {
-          auto it = train_map.find(trans.trainID_hash);
-          if (it == train_map.end() ||
-              trans.trainID_hash == train.trainID_hash ||
-              trans.station_index >= to_vector[it->second].station_index) {
-            continue;
-          }
-
-          if (trans.saleDate.second + trans.leavingTime.date <
-              arriveTime.date) {
-            continue;
-          }
-          DateTime latetime(arriveTime.date, trans.leavingTime.time);
-
-          if (latetime < arriveTime) {
-            latetime.date++;
-          }
-          if (latetime.date > trans.saleDate.second + trans.leavingTime.date) {
-            continue;
-          }
-          if (latetime.date < trans.saleDate.first + trans.leavingTime.date) {
-            latetime.date = trans.saleDate.first + trans.leavingTime.date;
-          }
-
-          auto &to_train = to_vector[it->second];
-          vector<TicketDateInfo> ticketNum_1, ticketNum_2;
-          ticket_db_->GetValue(
-              TrainDate(train.trainID_hash, date - train.leavingTime.date),
-              &ticketNum_1);
-          ticket_db_->GetValue(
-              TrainDate(trans.trainID_hash,
-                        latetime.date - trans.leavingTime.date),
-              &ticketNum_2);
-          auto t_num_1 = ticketNum_1[0].getSeat(train.station_index, i);
-          auto t_num_2 = ticketNum_2[0].getSeat(trans.station_index,
-                                                to_train.station_index);
-          TicketComp ticket_1(arriveTime - init_leaveTime, cost, t_num_1,
-                              train.station_index, i, init_leaveTime,
-                              arriveTime, train.trainID_hash, train.trainID);
-          TicketComp ticket_2(
-              to_train.arrivingTime - latetime, to_train.price - trans.price,
-              t_num_2, trans.station_index, to_train.station_index, latetime,
-              DateTime(latetime.date - trans.leavingTime.date +
-                           to_train.arrivingTime.date,
-                       to_train.arrivingTime.time),
-              trans.trainID_hash, trans.trainID);
-          TicketTransComp ticket(ticket_1, ticket_2, trainInfo->stations[i]);
-          queue.push(ticket);
-        }
-      }
-    }
+    for_each_transfer([&](TicketTransComp ticket) { queue.push(ticket); });
     if (queue.empty()) {
       std::cout << "0\n";
       return;
     } else {
       auto ticket = queue.top();
+      fill_seats(ticket);
+      auto station = stations_->Name(ticket.station);
       std::cout << ticket.ticket_1.trainID << ' ' << from << ' '
-                << ticket.ticket_1.leavingTime << " -> " << ticket.station
+                << ticket.ticket_1.leavingTime << " -> " << station
                 << ' ' << ticket.ticket_1.arrivingTime << ' '
                 << ticket.ticket_1.cost << ' ' << ticket.ticket_1.ticket_num
                 << '\n'
-                << ticket.ticket_2.trainID << ' ' << ticket.station << ' '
+                << ticket.ticket_2.trainID << ' ' << station << ' '
                 << ticket.ticket_2.leavingTime << " -> " << to << ' '
                 << ticket.ticket_2.arrivingTime << ' ' << ticket.ticket_2.cost
                 << ' ' << ticket.ticket_2.ticket_num << '\n';
@@ -372,17 +295,22 @@ void Ticket::BuyTicket(int timestamp, std::string &username,
                        std::string &trainID, num_t date, int num,
                        std::string &from, std::string &to, std::string queue) {
   auto user_hash = ToHash(username);
-  auto train_hash = ToHash(trainID);
   if (!user_->IsLogged(username)) {
     std::cout << "-1\n";
     return;
   }
-  auto from_hash = ToHash(from);
+  auto train_id = catalog_->Find(trainID);
+  auto from_id = stations_->Find(from);
+  auto to_id = stations_->Find(to);
+  if (train_id == INVALID_TRAIN_ID || from_id == INVALID_STATION_ID ||
+      to_id == INVALID_STATION_ID) {
+    std::cout << "-1\n";
+    return;
+  }
   vector<StationTrainInfo> from_vector;
-  station_db_->GetValue(StationTrain(from_hash, train_hash), &from_vector);
-  auto to_hash = ToHash(to);
+  station_db_->GetValue(StationTrain(from_id, train_id), &from_vector);
   vector<StationTrainInfo> to_vector;
-  station_db_->GetValue(StationTrain(to_hash, train_hash), &to_vector);
+  station_db_->GetValue(StationTrain(to_id, train_id), &to_vector);
   if (from_vector.empty() || to_vector.empty()) {
     std::cout << "-1\n";
     return;
@@ -400,22 +328,28 @@ void Ticket::BuyTicket(int timestamp, std::string &username,
       to_station.arrivingTime.time);
 
   auto init_date = date - from_station.leavingTime.date;
-  vector<TicketDateInfo> ticket_vector;
-  ticket_db_->GetValue(TrainDate(train_hash, init_date), &ticket_vector);
-  if (ticket_vector.empty() || ticket_vector[0].seatMaxNum < num) {
+  // seats are taken inside the same descent that checks them
+  int ticket_num = -1;
+  ticket_db_->Update(TrainDate(train_id, init_date),
+                     [&](TicketDateInfo &ticket) {
+                       if (ticket.seatMaxNum < num) {
+                         return;
+                       }
+                       ticket_num = ticket.getSeat(from_station.station_index,
+                                                   to_station.station_index);
+                       if (ticket_num >= num) {
+                         ticket.changeSeat(from_station.station_index,
+                                           to_station.station_index, -num);
+                       }
+                     });
+  if (ticket_num == -1) {
     std::cout << "-1\n";
     return;
   }
-  auto ticket_num = ticket_vector[0].getSeat(from_station.station_index,
-                                             to_station.station_index);
   if (ticket_num >= num) {
-    ticket_vector[0].changeSeat(from_station.station_index,
-                                to_station.station_index, -num);
-    ticket_db_->Remove(TrainDate(train_hash, init_date));
-    ticket_db_->Insert(TrainDate(train_hash, init_date), ticket_vector[0]);
     auto price = to_station.price - from_station.price;
-    OrderInfo order(timestamp, TicketStatus::Success, trainID.c_str(),
-                    from.c_str(), to.c_str(), from_station.station_index,
+    OrderInfo order(timestamp, TicketStatus::Success, train_id, from_id,
+                    to_id, from_station.station_index,
                     to_station.station_index, leavingTime, arrivingTime, price,
                     num, init_date);
     order_db_->Insert(OrderTime(user_hash, timestamp), order);
@@ -426,20 +360,21 @@ void Ticket::BuyTicket(int timestamp, std::string &username,
       return;
     }
     auto price = to_station.price - from_station.price;
-    OrderInfo order(timestamp, TicketStatus::Pending, trainID.c_str(),
-                    from.c_str(), to.c_str(), from_station.station_index,
+    OrderInfo order(timestamp, TicketStatus::Pending, train_id, from_id,
+                    to_id, from_station.station_index,
                     to_station.station_index, leavingTime, arrivingTime, price,
                     num, init_date);
     order_db_->Insert(OrderTime(user_hash, timestamp), order);
     PendingInfo pending_info{timestamp,
                              user_hash,
-                             train_hash,
+                             train_id,
                              from_station.station_index,
                              to_station.station_index,
                              num,
                              (num_t)init_date};
-    pending_db_->Insert(
-        TrainDateOrder(TrainDate(train_hash, init_date), timestamp),
+    // the timestamp makes the key unique, so it is written without a lookup
+    pending_db_->Upsert(
+        TrainDateOrder(TrainDate(train_id, init_date), timestamp),
         pending_info);
     std::cout << "queue\n";
   }
@@ -451,21 +386,23 @@ void Ticket::RefundTicket(std::string &username, int n) {
     std::cout << "-1\n";
     return;
   }
-  vector<OrderInfo> user_order_info;
-  order_db_->GetAllValue(OrderTime(user_hash, -1), &user_order_info);
-  auto order_size = user_order_info.size();
-  if (order_size < n) {
+  auto order_prefix = OrderTime(user_hash, -1);
+  auto order_size = order_db_->CountPrefix(order_prefix);
+  if (n <= 0 || order_size < n) {
     std::cout << "-1\n";
     return;
   }
-  auto &obj_order = user_order_info[order_size - n];
+  auto obj_order =
+      order_db_->SelectNthInPrefix(order_prefix, order_size - n).Value();
+  auto mark_refunded = [](OrderInfo &order) {
+    order.status = TicketStatus::Refunded;
+  };
   if (obj_order.status != TicketStatus::Success) {
     if (obj_order.status == TicketStatus::Pending) {
-      obj_order.status = TicketStatus::Refunded;
-      order_db_->Remove(OrderTime(user_hash, obj_order.timestamp));
-      order_db_->Insert(OrderTime(user_hash, obj_order.timestamp), obj_order);
+      order_db_->Update(OrderTime(user_hash, obj_order.timestamp),
+                        mark_refunded);
       pending_db_->Remove(TrainDateOrder(
-          TrainDate(ToHash(obj_order.trainID), obj_order.init_date),
+          TrainDate(obj_order.train, obj_order.init_date),
           obj_order.timestamp));
       std::cout << "0\n";
       return;
@@ -473,49 +410,37 @@ void Ticket::RefundTicket(std::string &username, int n) {
     std::cout << "-1\n";
     return;
   }
-  auto train_hash = ToHash(obj_order.trainID);
-  obj_order.status = TicketStatus::Refunded;
-  order_db_->Remove(OrderTime(user_hash, obj_order.timestamp));
-  order_db_->Insert(OrderTime(user_hash, obj_order.timestamp), obj_order);
+  auto train_id = obj_order.train;
+  order_db_->Update(OrderTime(user_hash, obj_order.timestamp), mark_refunded);
   vector<TicketDateInfo> ticket_vector;
-  ticket_db_->GetValue(TrainDate(train_hash, obj_order.init_date),
+  ticket_db_->GetValue(TrainDate(train_id, obj_order.init_date),
                        &ticket_vector);
   auto &cur_ticket = ticket_vector[0];
   cur_ticket.changeSeat(obj_order.from_index, obj_order.to_index,
                         obj_order.num);
-  vector<PendingInfo> pending_vector;
-  pending_db_->GetAllValue(
-      TrainDateOrder(TrainDate(train_hash, obj_order.init_date), -1),
-      &pending_vector);
-  auto pending_size = pending_vector.size();
-  if (pending_size == 0) {
-    ticket_db_->Remove(TrainDate(train_hash, obj_order.init_date));
-    ticket_db_->Insert(TrainDate(train_hash, obj_order.init_date), cur_ticket);
-    std::cout << "0\n";
-    return;
-  }
-  for (int i = 0; i < pending_size; ++i) {
-    auto &pending_order = pending_vector[i];
+  // The pending queue cannot shrink while it is being scanned, so the
+  // satisfied entries are only collected here and removed afterwards.
+  auto pending_prefix =
+      TrainDateOrder(TrainDate(train_id, obj_order.init_date), -1);
+  vector<int> satisfied;
+  pending_db_->Scan(pending_prefix, [&](const TrainDateOrder &,
+                                        const PendingInfo &pending_order) {
     if (pending_order.num <=
         cur_ticket.getSeat(pending_order.from_index, pending_order.to_index)) {
       cur_ticket.changeSeat(pending_order.from_index, pending_order.to_index,
                             -pending_order.num);
-      vector<OrderInfo> order_info;
-      order_db_->GetValue(
+      order_db_->Update(
           OrderTime(pending_order.username_hash, pending_order.timestamp),
-          &order_info);
-      order_info[0].status = TicketStatus::Success;
-      order_db_->Remove(
-          OrderTime(pending_order.username_hash, pending_order.timestamp));
-      order_db_->Insert(
-          OrderTime(pending_order.username_hash, pending_order.timestamp),
-          order_info[0]);
-      pending_db_->Remove(TrainDateOrder(
-          TrainDate(train_hash, obj_order.init_date), pending_order.timestamp));
+          [](OrderInfo &order) { order.status = TicketStatus::Success; });
+      satisfied.push_back(pending_order.timestamp);
     }
+    return true;
+  });
+  for (int i = 0; i < satisfied.size(); ++i) {
+    pending_db_->Remove(TrainDateOrder(
+        TrainDate(train_id, obj_order.init_date), satisfied[i]));
   }
-  ticket_db_->Remove(TrainDate(train_hash, obj_order.init_date));
-  ticket_db_->Insert(TrainDate(train_hash, obj_order.init_date), cur_ticket);
+  ticket_db_->Upsert(TrainDate(train_id, obj_order.init_date), cur_ticket);
   std::cout << "0\n";
 }
 
@@ -525,11 +450,10 @@ void Ticket::QueryOrder(std::string &username) {
     std::cout << "-1\n";
     return;
   }
-  vector<OrderInfo> order_vector;
-  order_db_->GetAllValue(OrderTime(user_hash, -1), &order_vector);
-  std::cout << order_vector.size() << '\n';
-  for (int i = order_vector.size() - 1; i >= 0; --i) {
-    auto &order = order_vector[i];
+  auto order_prefix = OrderTime(user_hash, -1);
+  std::cout << order_db_->CountPrefix(order_prefix) << '\n';
+  order_db_->ScanReverse(order_prefix, [&](const OrderTime &,
+                                          const OrderInfo &order) {
     if (order.status == TicketStatus::Success) {
       std::cout << "[success] ";
     } else if (order.status == TicketStatus::Pending) {
@@ -537,9 +461,25 @@ void Ticket::QueryOrder(std::string &username) {
     } else {
       std::cout << "[refunded] ";
     }
-    std::cout << order.trainID << ' ' << order.from << ' ' << order.leavingTime
-              << " -> " << order.to << ' ' << order.arrivingTime << ' '
-              << order.price << ' ' << order.num << '\n';
-  }
+    std::cout << catalog_->Name(order.train) << ' '
+              << stations_->Name(order.from) << ' ' << order.leavingTime
+              << " -> " << stations_->Name(order.to) << ' '
+              << order.arrivingTime << ' ' << order.price << ' ' << order.num << '\n';
+    return true;
+  });
+}
+
+void Ticket::Inspect() {
+  ticket_db_->Stats().Print(std::cout, "ticket_db");
+  order_db_->Stats().Print(std::cout, "order_db");
+  pending_db_->PrintStats(std::cout, "pending_db");
+  station_db_->Stats().Print(std::cout, "station_db");
+}
+
+void Ticket::Compact() {
+  ticket_db_->Compact();
+  order_db_->Compact();
+  pending_db_->Compact();
+  station_db_->Compact();
 }
 }  // namespace sjtu
\ No newline at end of file
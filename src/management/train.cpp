@@ -4,15 +4,14 @@
 
 namespace sjtu {
 Train::Train(std::string &name, Ticket *ticket) : ticket_(ticket) {
-  HashComp comp;
-  train_db_ =
-      std::make_unique<BPlusTree<hash_t, TrainMeta, HashComp, HashComp> >(
-          "train_db", comp, comp, 256);
   train_manager_ = std::make_unique<BufferPoolManager>(128, "train_manager");
   header_page_id_ = train_manager_->NewPage();
   WritePageGuard guard = train_manager_->WritePage(header_page_id_);
   auto root_page = guard.AsMut<BPlusTreeHeaderPage>();
-  train_manager_->SetNextPageId(root_page->next_page_id_);
+  // a new file has no trains yet, which must not overwrite the header
+  if (root_page->next_page_id_ != 0) {
+    train_manager_->SetNextPageId(root_page->next_page_id_);
+  }
 }
 
 Train::~Train() {
@@ -21,135 +20,119 @@ Train::~Train() {
   header_page->next_page_id_ = train_manager_->GetNextPageId();
 }
 
-void Train::AddTrain(TrainInfo &train) {
-  vector<TrainMeta> train_vector;
-  train_db_->GetValue(train.train_id_hash, &train_vector);
-  if (!train_vector.empty()) {
+void Train::AddTrain(TrainInfo &train, std::string &stations) {
+  auto catalog = ticket_->catalog_;
+  std::string trainID = train.trainID;
+  if (catalog->Find(trainID) != INVALID_TRAIN_ID) {
     std::cout << "-1\n";
     return;
   }
+  std::istringstream iss(stations);
+  std::string station;
+  for (int i = 0; getline(iss, station, '|'); ++i) {
+    train.stations[i] = ticket_->stations_->Intern(station);
+  }
   TrainMeta train_meta{train_manager_->NewPage(), train.saleDate, false};
-  train_db_->Insert(train.train_id_hash, train_meta);
+  strncpy(train_meta.trainID, train.trainID, 20);
+  catalog->Add(train_meta);
   *train_manager_->WritePage(train_meta.page_id).AsMut<TrainInfo>() = train;
   std::cout << "0\n";
 }
 
 void Train::DeleteTrain(std::string &trainID) {
-  auto train_hash = ToHash(trainID);
-  vector<TrainMeta> train_vector;
-  train_db_->GetValue(train_hash, &train_vector);
-  if (train_vector.empty() || train_vector[0].is_released) {
+  auto catalog = ticket_->catalog_;
+  auto train_id = catalog->Find(trainID);
+  if (train_id == INVALID_TRAIN_ID || catalog->Meta(train_id).is_released) {
     std::cout << "-1\n";
     return;
   }
-  train_db_->Remove(train_hash);
+  catalog->Remove(train_id);
   std::cout << "0\n";
   return;
 }
 
 void Train::QueryTrain(std::string &trainID, num_t date) {
-  auto train_hash = ToHash(trainID);
-  vector<TrainMeta> train_vector;
-  train_db_->GetValue(train_hash, &train_vector);
-  if (train_vector.empty() || date <= 0 || date > 92) {
+  auto train_id = ticket_->catalog_->Find(trainID);
+  if (train_id == INVALID_TRAIN_ID || date <= 0 || date > 92) {
     std::cout << "-1\n";
     return;
   }
-  if (train_vector[0].saleDate.second < date ||
-      train_vector[0].saleDate.first > date) {
+  auto train_meta = ticket_->catalog_->Meta(train_id);
+  if (train_meta.saleDate.second < date || train_meta.saleDate.first > date) {
     std::cout << "-1\n";
     return;
   }
-  auto train =
-      train_manager_->ReadPage(train_vector[0].page_id).As<TrainInfo>();
+  auto train_guard = train_manager_->ReadPage(train_meta.page_id);
+  auto train = train_guard.As<TrainInfo>();
+  auto stations = ticket_->stations_;
   std::cout << train->trainID << ' ' << train->type << '\n';
-  if (train_vector[0].is_released) {
-    sjtu::vector<TicketDateInfo> ticket_vector;
-    TrainDate cur{train_hash, date};
-    ticket_->ticket_db_->GetValue(cur, &ticket_vector);
-    DateTime cur_time(date, train->startTime);
-    int cur_price = 0;
-    std::cout << train->stations[0] << " xx-xx xx:xx -> " << cur_time << ' '
-              << cur_price << ' ' << ticket_vector[0].seatNum[0] << '\n';
-    for (int i = 1; i < train->stationNum - 1; ++i) {
-      cur_time += train->travelTimes[i - 1];
-      std::cout << train->stations[i] << ' ' << cur_time << " -> ";
-      cur_time += train->stopoverTimes[i - 1];
-      cur_price += train->prices[i - 1];
-      std::cout << cur_time << ' ' << cur_price << ' '
-                << ticket_vector[0].seatNum[i] << '\n';
+  sjtu::vector<TicketDateInfo> ticket_vector;
+  if (train_meta.is_released) {
+    ticket_->ticket_db_->GetValue(TrainDate(train_id, date), &ticket_vector);
+  }
+  auto last = train->stationNum - 1;
+  for (int i = 0; i <= last; ++i) {
+    std::cout << stations->Name(train->stations[i]) << ' ';
+    if (i == 0) {
+      std::cout << "xx-xx xx:xx";
+    } else {
+      std::cout << DateTime(date, train->startTime + train->arrivingOffsets[i]);
     }
-    cur_time += train->travelTimes[train->stationNum - 2];
-    cur_price += train->prices[train->stationNum - 2];
-    std::cout << train->stations[train->stationNum - 1] << ' ' << cur_time
-              << " -> xx-xx xx:xx " << cur_price << " x \n";
-  } else {
-    DateTime cur_time(date, train->startTime);
-    int cur_price = 0;
-    std::cout << train->stations[0] << " xx-xx xx:xx -> " << cur_time << ' '
-              << cur_price << ' ' << train->seatNum << '\n';
-    for (int i = 1; i < train->stationNum - 1; ++i) {
-      cur_time += train->travelTimes[i - 1];
-      std::cout << train->stations[i] << ' ' << cur_time << " -> ";
-      cur_time += train->stopoverTimes[i - 1];
-      cur_price += train->prices[i - 1];
-      std::cout << cur_time << ' ' << cur_price << ' ' << train->seatNum
-                << '\n';
+    std::cout << " -> ";
+    if (i == last) {
+      std::cout << "xx-xx xx:xx " << train->prices[i] << " x \n";
+      break;
     }
-    cur_time += train->travelTimes[train->stationNum - 2];
-    cur_price += train->prices[train->stationNum - 2];
-    std::cout << train->stations[train->stationNum - 1] << ' ' << cur_time
-              << " -> xx-xx xx:xx " << cur_price << " x \n";
+    // seats are only sold once the train is released
+    auto seat_num = train_meta.is_released ? ticket_vector[0].seatNum[i]
+                                           : train->seatNum;
+    std::cout << DateTime(date, train->startTime + train->leavingOffsets[i])
+              << ' ' << train->prices[i] << ' ' << seat_num << '\n';
   }
 }
 
 void Train::ReleaseTrain(std::string &trainID) {
-  auto train_hash = ToHash(trainID);
-  vector<TrainMeta> train_vector;
-  train_db_->GetValue(train_hash, &train_vector);
-  if (train_vector.empty() || train_vector[0].is_released) {
+  auto catalog = ticket_->catalog_;
+  auto train_id = catalog->Find(trainID);
+  if (train_id == INVALID_TRAIN_ID) {
+    std::cout << "-1\n";
+    return;
+  }
+  auto train_meta = catalog->Meta(train_id);
+  if (train_meta.is_released) {
     std::cout << "-1\n";
     return;
   }
-  train_vector[0].is_released = true;
-  train_db_->Remove(train_hash);
-  train_db_->Insert(train_hash, train_vector[0]);
-  auto train =
-      train_manager_->ReadPage(train_vector[0].page_id).As<TrainInfo>();
+  catalog->SetReleased(train_id);
+  auto train_guard = train_manager_->ReadPage(train_meta.page_id);
+  auto train = train_guard.As<TrainInfo>();
   TicketDateInfo cur_ticket(train->seatNum, train->stationNum);
+  vector<TrainDate> date_keys;
+  vector<TicketDateInfo> date_tickets;
   for (auto i = train->saleDate.first; i <= train->saleDate.second; ++i) {
-    TrainDate train_date{train_hash, i};
-    ticket_->ticket_db_->Insert(train_date, cur_ticket);
+    date_keys.push_back(TrainDate(train_id, i));
+    date_tickets.push_back(cur_ticket);
+  }
+  ticket_->ticket_db_->InsertBatch(date_keys, date_tickets);
+
+  // station keys are scattered, sort them so the batch visits leaves in order
+  map<StationTrain, StationTrainInfo> station_map;
+  for (auto i = 0; i < train->stationNum; ++i) {
+    station_map.insert(
+        StationTrain(train->stations[i], train_id),
+        StationTrainInfo(
+            i, train->prices[i], train->saleDate,
+            DateTime(0, train->startTime + train->arrivingOffsets[i]),
+            DateTime(0, train->startTime + train->leavingOffsets[i])));
   }
-  auto cur_time = DateTime(0, train->startTime);
-  std::string str(train->stations[0]);
-  auto station_hash = ToHash(str);
-  StationTrainInfo station_train(train->train_id_hash, train->trainID, 0, 0,
-                                 train->saleDate, cur_time, cur_time);
 
-  ticket_->station_db_->Insert(StationTrain(station_hash, train_hash),
-                               station_train);
-  for (auto i = 1; i < train->stationNum - 1; ++i) {
-    str = std::string(train->stations[i]);
-    station_hash = ToHash(str);
-    station_train.station_index = i;
-    station_train.price += train->prices[i - 1];
-    station_train.arrivingTime = station_train.leavingTime;
-    station_train.arrivingTime += train->travelTimes[i - 1];
-    station_train.leavingTime = station_train.arrivingTime;
-    station_train.leavingTime += train->stopoverTimes[i - 1];
-    ticket_->station_db_->Insert(StationTrain(station_hash, train_hash),
-                                 station_train);
+  vector<StationTrain> station_keys;
+  vector<StationTrainInfo> station_infos;
+  for (auto it = station_map.begin(); it != station_map.end(); ++it) {
+    station_keys.push_back(it->first);
+    station_infos.push_back(it->second);
   }
-  str = std::string(train->stations[train->stationNum - 1]);
-  station_hash = ToHash(str);
-  station_train.station_index = train->stationNum - 1;
-  station_train.price += train->prices[train->stationNum - 2];
-  station_train.arrivingTime = station_train.leavingTime;
-  station_train.arrivingTime += train->travelTimes[train->stationNum - 2];
-  station_train.leavingTime = station_train.arrivingTime;
-  ticket_->station_db_->Insert(StationTrain(station_hash, train_hash),
-                               station_train);
+  ticket_->station_db_->InsertBatch(station_keys, station_infos);
   std::cout << "0\n";
 }
 }  // namespace sjtu
\ No newline at end of file
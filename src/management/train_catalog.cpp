@@ -0,0 +1,72 @@
+#include "management/train_catalog.h"
+
+namespace sjtu {
+TrainCatalog::TrainCatalog(const std::string &name) {
+  HashComp comp;
+  id_db_ = std::make_unique<ExtendibleHashTable<hash_t, train_t, HashComp> >(
+      name + "_train_ids", comp, 64);
+  catalog_manager_ =
+      std::make_unique<BufferPoolManager>(64, name + "_train_catalog");
+  header_page_id_ = catalog_manager_->NewPage();
+  auto guard = catalog_manager_->WritePage(header_page_id_);
+  auto header_page = guard.AsMut<TrainCatalogHeaderPage>();
+  if (header_page->next_page_id_ != 0) {
+    catalog_manager_->SetNextPageId(header_page->next_page_id_);
+  }
+  train_cnt_ = header_page->train_cnt_;
+}
+
+TrainCatalog::~TrainCatalog() {
+  auto guard = catalog_manager_->WritePage(header_page_id_);
+  auto header_page = guard.AsMut<TrainCatalogHeaderPage>();
+  header_page->next_page_id_ = catalog_manager_->GetNextPageId();
+  header_page->train_cnt_ = train_cnt_;
+}
+
+auto TrainCatalog::Find(std::string &trainID) -> train_t {
+  vector<train_t> id_vector;
+  if (!id_db_->GetValue(ToHash(trainID), &id_vector)) {
+    return INVALID_TRAIN_ID;
+  }
+  return id_vector[0];
+}
+
+auto TrainCatalog::Add(const TrainMeta &meta) -> train_t {
+  auto id = train_cnt_++;
+  if (id % TrainCatalogPage::SLOT_CNT == 0) {
+    catalog_manager_->NewPage();
+  }
+  auto guard = catalog_manager_->WritePage(MetaPageId(id));
+  guard.AsMut<TrainCatalogPage>()->metas_[id % TrainCatalogPage::SLOT_CNT] =
+      meta;
+  id_db_->Insert(ToHash(meta.trainID), id);
+  return id;
+}
+
+void TrainCatalog::Remove(train_t id) {
+  id_db_->Remove(ToHash(Meta(id).trainID));
+}
+
+auto TrainCatalog::Meta(train_t id) -> TrainMeta {
+  auto guard = catalog_manager_->ReadPage(MetaPageId(id));
+  return guard.As<TrainCatalogPage>()->metas_[id % TrainCatalogPage::SLOT_CNT];
+}
+
+auto TrainCatalog::Name(train_t id) -> std::string {
+  auto guard = catalog_manager_->ReadPage(MetaPageId(id));
+  return guard.As<TrainCatalogPage>()
+      ->metas_[id % TrainCatalogPage::SLOT_CNT]
+      .trainID;
+}
+
+void TrainCatalog::SetReleased(train_t id) {
+  auto guard = catalog_manager_->WritePage(MetaPageId(id));
+  guard.AsMut<TrainCatalogPage>()
+      ->metas_[id % TrainCatalogPage::SLOT_CNT]
+      .is_released = true;
+}
+
+auto TrainCatalog::MetaPageId(train_t id) const -> page_id_t {
+  return header_page_id_ + 1 + static_cast<page_id_t>(id / TrainCatalogPage::SLOT_CNT);
+}
+}  // namespace sjtu
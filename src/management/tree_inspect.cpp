@@ -0,0 +1,57 @@
+/**
+ * tree_inspect.cpp
+ *
+ * Prints the Stats of every B+ tree index of a ticket system database without
+ * writing to its files, so it can be pointed at the files of a running or
+ * crashed system.
+ *
+ * Usage: tree_inspect [name], name defaults to ticket_system.
+ * Exits with 1 if any index fails verification.
+ */
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "common/rid.h"
+#include "management/ticket.h"
+#include "storage/b_plus_tree.h"
+
+namespace {
+template <typename Tree, typename Comparator, typename DegradedComparator>
+auto Inspect(const std::string &file) -> bool {
+  if (!std::filesystem::exists(file)) {
+    std::cout << file << ": missing\n";
+    return true;
+  }
+  Comparator comparator;
+  DegradedComparator degraded_comparator;
+  Tree tree(file, comparator, degraded_comparator, 64, Tree::LEAF_MAX_SIZE,
+            Tree::INTERNAL_MAX_SIZE, false, true);
+  auto stats = tree.Stats();
+  stats.Print(std::cout, file);
+  return stats.IsHealthy();
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  using namespace sjtu;
+  std::string name = argc > 1 ? argv[1] : "ticket_system";
+  bool healthy = true;
+  healthy &= Inspect<BPlusTree<TrainDate, RID, PairCompare<TrainDate>,
+                               PairDegradedCompare<TrainDate> >,
+                     PairCompare<TrainDate>, PairDegradedCompare<TrainDate> >(
+      name + "_ticket_db");
+  healthy &= Inspect<BPlusTree<OrderTime, OrderInfo, PairCompare<OrderTime>,
+                               PairDegradedCompare<OrderTime> >,
+                     PairCompare<OrderTime>, PairDegradedCompare<OrderTime> >(
+      name + "_order_db");
+  healthy &= Inspect<BPlusTree<TrainDateOrder, PendingInfo, TDOCompare,
+                               TDODegradedCompare>,
+                     TDOCompare, TDODegradedCompare>(name + "_pending_db");
+  healthy &= Inspect<BPlusTree<StationTrain, StationTrainInfo,
+                               PairCompare<StationTrain>,
+                               PairDegradedCompare<StationTrain> >,
+                     PairCompare<StationTrain>, PairDegradedCompare<StationTrain> >(
+      name + "_station_db");
+  return healthy ? 0 : 1;
+}
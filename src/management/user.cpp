@@ -5,8 +5,8 @@
 namespace sjtu {
 User::User(std::string &name) {
   HashComp comp;
-  user_db_ = std::make_unique<BPlusTree<hash_t, UserInfo, HashComp, HashComp> >(
-      name + "_db", comp, comp, 128);
+  user_db_ = std::make_unique<ExtendibleHashTable<hash_t, UserInfo, HashComp> >(
+      name + "_db", comp, 128);
 }
 
 void User::AddUser(std::string &cur_username, UserInfo &user) {
@@ -137,8 +137,7 @@ void User::ModifyProfile(std::string &cur_username, UserInfoOptional &user) {
   if (user.privilege.has_value()) {
     user_vector[0].privilege = user.privilege.value();
   }
-  user_db_->Remove(user.username_hash);
-  user_db_->Insert(user.username_hash, user_vector[0]);
+  user_db_->Upsert(user.username_hash, user_vector[0]);
 
   if (logged_user_.count(user.username_hash) != 0) {
     logged_user_.erase(user.username_hash);
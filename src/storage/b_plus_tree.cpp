@@ -9,39 +9,82 @@ BPLUSTREE_TYPE::BPlusTree(std::string name,
                           const KeyComparator& comparator,
                           const DegradedKeyComparator& degraded_comparator,
                           int bpm_max_size, int leaf_max_size,
-                          int internal_max_size)
+                          int internal_max_size, bool counted,
+                          bool read_only)
   : index_name_(std::move(name)),
     comparator_(std::move(comparator)),
     degraded_comparator_(std::move(degraded_comparator)),
     leaf_max_size_(leaf_max_size),
     internal_max_size_(internal_max_size) {
-  bpm_ = new sjtu::BufferPoolManager(bpm_max_size, index_name_);
+  bpm_ = new sjtu::BufferPoolManager(bpm_max_size, index_name_,
+                                     LRUK_REPLACER_K, read_only);
   header_page_id_ = bpm_->NewPage();
   WritePageGuard guard = bpm_->WritePage(header_page_id_);
   auto root_page = guard.AsMut<BPlusTreeHeaderPage>();
   if (root_page->root_page_id_ == 0) {
     root_page->root_page_id_ = INVALID_PAGE_ID;
+    root_page->counted_ = counted ? 1 : 0;
   } else {
     bpm_->SetNextPageId(root_page->next_page_id_);
   }
+  counted_ = root_page->counted_ != 0;
+  root_page_id_ = root_page->root_page_id_;
+  int pinned_cnt = std::min(PINNED_PAGE_CNT, bpm_max_size / 4);
+  for (int i = 0; i < pinned_cnt; ++i) {
+    pinned_.push_back(std::nullopt);
+  }
+  if (counted_ && internal_max_size_ > InternalPage::COUNTED_SLOT_CNT) {
+    internal_max_size_ = InternalPage::COUNTED_SLOT_CNT;
+  }
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 BPLUSTREE_TYPE::~BPlusTree() {
+  if (bloom_.IsEnabled()) {
+    auto guard = bpm_->WritePage(header_page_id_);
+    bloom_.Save(bpm_, &guard.AsMut<BPlusTreeHeaderPage>()->bloom_);
+  }
   bpm_->WritePage(header_page_id_).AsMut<sjtu::BPlusTreeHeaderPage>()->
       next_page_id_ = bpm_->GetNextPageId();
+  // unpin before the pool goes away
+  pinned_.clear();
+  for (int i = 0; i < snapshots_.size(); ++i) {
+    delete snapshots_[i];
+  }
   delete bpm_;
 }
 
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::SetUnderflowPolicy(UnderflowPolicy policy) {
+  underflow_policy_ = policy;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::EnableBloomFilter(int bits_per_key) {
+  bloom_bits_per_key_ = bits_per_key;
+  {
+    auto guard = bpm_->ReadPage(header_page_id_);
+    auto header = guard.As<BPlusTreeHeaderPage>()->bloom_;
+    if (!bloom_.Load(bpm_, header, bits_per_key) || bloom_.NeedsRebuild()) {
+      guard.Drop();
+      RebuildBloomFilter();
+    }
+  }
+  // The saved bits go stale with the first change, so they must not be
+  // trusted after a crash. Only the destructor marks them clean again.
+  auto guard = bpm_->WritePage(header_page_id_);
+  guard.AsMut<BPlusTreeHeaderPage>()->bloom_.clean_ = 0;
+  guard.Drop();
+  bpm_->FlushPage(header_page_id_);
+}
+
 /**
  * @brief Helper function to decide whether current b+tree is empty
  * @return Returns true if this B+ tree has no keys and values.
  */
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::IsEmpty() const -> bool {
-  ReadPageGuard guard = bpm_->ReadPage(header_page_id_);
-  auto root_page = guard.As<BPlusTreeHeaderPage>();
-  return root_page->root_page_id_ == INVALID_PAGE_ID;
+  return root_page_id_ == INVALID_PAGE_ID;
 }
 
 /*****************************************************************************
@@ -59,41 +102,126 @@ auto BPLUSTREE_TYPE::IsEmpty() const -> bool {
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::GetValue(const KeyType& key,
                               sjtu::vector<ValueType>* result) -> bool {
-  // Declaration of context instance.
-  auto head_guard = bpm_->ReadPage(header_page_id_);
-  auto head_page = head_guard.As<BPlusTreeHeaderPage>();
-  if (head_page->root_page_id_ == INVALID_PAGE_ID) {
+  if (!MayContain(key)) {
+    return false;
+  }
+  if (root_page_id_ == INVALID_PAGE_ID) {
     return false;
   }
-  auto cur_guard = bpm_->ReadPage(head_page->root_page_id_);
-  auto cur_page = cur_guard.As<BPlusTreePage>();
+  ReadPageGuard cur_guard;
+  auto cur_page = ReadNode(root_page_id_, 0, &cur_guard);
+  for (int depth = 1; !cur_page->IsLeafPage(); ++depth) {
+    auto page = static_cast<const InternalPage*>(cur_page);
+    auto slot = page->LookUp(key, comparator_);
+    cur_page = ReadNode(page->ValueAt(slot), depth, &cur_guard);
+  }
 
-  while (!cur_page->IsLeafPage()) {
-    auto page = cur_guard.As<InternalPage>();
-    auto page_size = page->GetSize();
-    auto slot = page_size - 1;
-    for (int i = 1; i < page_size; ++i) {
-      if (comparator_(page->KeyAt(i), key) >= 0) {
-        slot = i;
-        break;
-      }
+  auto leaf_page = static_cast<const LeafPage*>(cur_page);
+  auto index = leaf_page->KeyIndex(key, comparator_);
+  if (index < leaf_page->GetSize() &&
+      comparator_(key, leaf_page->KeyAt(index)) == 0) {
+    result->push_back(leaf_page->RidAt(index));
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Point lookups of a batch of keys sharing their descents
+ *
+ * Keys the Bloom filter rules out are dropped first, the rest are sorted and
+ * split among the children of each page on the way down, so every page is
+ * read once however many keys lead to it.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::MultiGet(const sjtu::vector<KeyType>& keys,
+                              sjtu::vector<std::optional<ValueType> >* result) -> int {
+  result->clear();
+  sjtu::vector<int> order;
+  for (int i = 0; i < keys.size(); ++i) {
+    result->push_back(std::nullopt);
+    if (MayContain(keys[i])) {
+      order.push_back(i);
     }
-    if (comparator_(key, page->KeyAt(slot)) < 0) {
-      --slot;
+  }
+  if (root_page_id_ == INVALID_PAGE_ID || order.empty()) {
+    return 0;
+  }
+  SortProbes(keys, &order);
+  return MultiGetSubtree(root_page_id_, 0, keys, order, 0, order.size(), result);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::SortProbes(const sjtu::vector<KeyType>& keys,
+                                sjtu::vector<int>* order) const {
+  int n = order->size();
+  sjtu::vector<int> buffer(*order);
+  // bottom-up merge sort, stable
+  for (int width = 1; width < n; width *= 2) {
+    for (int low = 0; low < n; low += 2 * width) {
+      int mid = std::min(low + width, n);
+      int high = std::min(low + 2 * width, n);
+      int i = low;
+      int j = mid;
+      int k = low;
+      while (i < mid && j < high) {
+        buffer[k++] = comparator_(keys[(*order)[j]], keys[(*order)[i]]) < 0
+                        ? (*order)[j++]
+                        : (*order)[i++];
+      }
+      while (i < mid) {
+        buffer[k++] = (*order)[i++];
+      }
+      while (j < high) {
+        buffer[k++] = (*order)[j++];
+      }
     }
-    cur_guard = bpm_->ReadPage(page->ValueAt(slot));
-    cur_page = cur_guard.As<BPlusTreePage>();
+    std::swap(*order, buffer);
   }
+}
 
-  auto leaf_page = cur_guard.As<LeafPage>();
-  auto leaf_size = leaf_page->GetSize();
-  for (int i = 0; i < leaf_size; ++i) {
-    if (comparator_(key, leaf_page->KeyAt(i)) == 0) {
-      result->push_back(leaf_page->RidAt(i));
-      return true;
+/**
+ * @brief Look up keys[order[begin, end)], which all lead to page_id
+ *
+ * @return number of keys found
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::MultiGetSubtree(page_id_t page_id, int depth,
+                                     const sjtu::vector<KeyType>& keys,
+                                     const sjtu::vector<int>& order, int begin,
+                                     int end,
+                                     sjtu::vector<std::optional<ValueType> >* result)
+    -> int {
+  ReadPageGuard guard;
+  auto page = ReadNode(page_id, depth, &guard);
+  int found = 0;
+  if (page->IsLeafPage()) {
+    auto leaf_page = static_cast<const LeafPage*>(page);
+    for (int i = begin; i < end; ++i) {
+      auto& key = keys[order[i]];
+      auto index = leaf_page->KeyIndex(key, comparator_);
+      if (index < leaf_page->GetSize() &&
+          comparator_(key, leaf_page->KeyAt(index)) == 0) {
+        (*result)[order[i]] = leaf_page->RidAt(index);
+        ++found;
+      }
     }
+    return found;
   }
-  return false;
+  auto internal_page = static_cast<const InternalPage*>(page);
+  for (int i = begin; i < end;) {
+    auto slot = internal_page->LookUp(keys[order[i]], comparator_);
+    // the sorted keys below the next separator share the child
+    int j = i + 1;
+    while (j < end && (slot + 1 >= internal_page->GetSize() ||
+                       comparator_(keys[order[j]], internal_page->KeyAt(slot + 1)) < 0)) {
+      ++j;
+    }
+    found += MultiGetSubtree(internal_page->ValueAt(slot), depth + 1, keys, order,
+                             i, j, result);
+    i = j;
+  }
+  return found;
 }
 
 /**
@@ -108,61 +236,122 @@ auto BPLUSTREE_TYPE::GetValue(const KeyType& key,
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::GetAllValue(const KeyType& key,
                                  sjtu::vector<ValueType>* result) -> bool {
-  // Declaration of context instance.
-  Context ctx;
-  auto head_guard = bpm_->ReadPage(header_page_id_);
-  auto head_page = head_guard.As<BPlusTreeHeaderPage>();
-  if (head_page->root_page_id_ == INVALID_PAGE_ID) {
-    return false;
+  return Scan(key, [result](const KeyType&, const ValueType& value) {
+    result->push_back(value);
+    return true;
+  }) > 0;
+}
+
+/**
+ * @brief Position a cursor for range scan
+ *
+ * @param key input key
+ * @return cursor at the first entry whose key is not less than key, or an end
+ * cursor if there is none
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::LowerBound(const KeyType& key) -> Iterator {
+  auto leaf_guard = FindLeafPage(key);
+  if (!leaf_guard.has_value()) {
+    return Iterator();
+  }
+  auto index = leaf_guard->template As<LeafPage>()->KeyIndex(key, comparator_);
+  return Iterator(bpm_, std::move(leaf_guard).value(), index);
+}
+
+/**
+ * @brief Position a cursor for reverse range scan
+ *
+ * @param prefix key compared under the degraded comparator
+ * @return cursor at the last entry matching prefix, or an end cursor if there
+ * is none
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::SeekLast(const KeyType& prefix) -> Iterator {
+  auto leaf_guard = FindLastLeafPage(prefix);
+  if (!leaf_guard.has_value()) {
+    return Iterator();
+  }
+  auto index = leaf_guard->template As<LeafPage>()->KeyUpperIndex(
+      prefix, degraded_comparator_);
+  Iterator it(bpm_, std::move(leaf_guard).value(), index > 0 ? index - 1 : 0);
+  if (index == 0) {
+    it.Prev();
+  }
+  if (it.IsEnd() || degraded_comparator_(prefix, it.Key()) != 0) {
+    return Iterator();
   }
-  ctx.read_set_.push_back(bpm_->ReadPage(head_page->root_page_id_));
-  auto cur_page = ctx.read_set_.back().As<BPlusTreePage>();
+  return it;
+}
 
-  while (!cur_page->IsLeafPage()) {
-    auto page = ctx.read_set_.back().As<InternalPage>();
-    auto page_size = page->GetSize();
-    auto slot = page_size - 1;
-    for (int i = 1; i < page_size; ++i) {
-      if (comparator_(page->KeyAt(i), key) >= 0) {
-        slot = i;
-        break;
-      }
-    }
-    if (comparator_(key, page->KeyAt(slot)) < 0) {
-      --slot;
-    }
-    ctx.read_set_.push_back(bpm_->ReadPage(page->ValueAt(slot)));
-    cur_page = ctx.read_set_.back().As<BPlusTreePage>();
+/**
+ * @brief Count the entries matching prefix under the degraded comparator
+ *
+ * Counted trees answer from the subtree counts of two root-to-leaf paths,
+ * other trees fall back to scanning the matching entries.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::CountPrefix(const KeyType& prefix) -> int {
+  if (!counted_) {
+    return Scan(prefix, [](const KeyType&, const ValueType&) { return true; });
   }
+  return CountBefore(prefix, true) - CountBefore(prefix, false);
+}
 
-  auto leaf_page = ctx.read_set_.back().As<LeafPage>();
-  auto leaf_size = leaf_page->GetSize();
-  for (int i = 0; i < leaf_size; ++i) {
-    auto flag = degraded_comparator_(key, leaf_page->KeyAt(i));
-    if (flag < 0) {
-      return true;
+/**
+ * @brief Position a cursor at the n-th entry matching prefix, counting from 0
+ * in key order
+ *
+ * Counted trees descend straight to the entry by subtree counts, other trees
+ * walk the matching entries from the first one.
+ *
+ * @return cursor at the entry, or an end cursor if fewer than n + 1 entries
+ * match prefix
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::SelectNthInPrefix(const KeyType& prefix, int n)
+  -> Iterator {
+  if (n < 0) {
+    return Iterator();
+  }
+  Iterator it;
+  if (!counted_) {
+    auto leaf_guard = FindLeafPage(prefix);
+    if (!leaf_guard.has_value()) {
+      return Iterator();
     }
-    if (flag == 0) {
-      result->push_back(leaf_page->RidAt(i));
+    auto index = leaf_guard->template As<LeafPage>()->KeyIndex(
+        prefix, degraded_comparator_);
+    it = Iterator(bpm_, std::move(leaf_guard).value(), index);
+    for (int i = 0; i < n && !it.IsEnd(); ++i) {
+      it.Next();
     }
-  }
-  auto next_page_id = leaf_page->GetNextPageId();
-  while (next_page_id != -1) {
-    auto next_guard = bpm_->ReadPage(next_page_id);
-    auto next_page = next_guard.template As<LeafPage>();
-    auto next_page_size = next_page->GetSize();
-    for (int i = 0; i < next_page_size; ++i) {
-      auto flag = degraded_comparator_(key, next_page->KeyAt(i));
-      if (flag < 0) {
-        return true;
-      }
-      if (flag == 0) {
-        result->push_back(next_page->RidAt(i));
+  } else {
+    auto root_id = GetRootPageId();
+    if (root_id == INVALID_PAGE_ID) {
+      return Iterator();
+    }
+    auto rank = CountBefore(prefix, false) + n;
+    ReadPageGuard cur_guard;
+    auto cur_page = ReadNode(root_id, 0, &cur_guard);
+    for (int depth = 1; !cur_page->IsLeafPage(); ++depth) {
+      auto page = static_cast<const InternalPage*>(cur_page);
+      int slot = 0;
+      while (slot < page->GetSize() - 1 && rank >= page->CountAt(slot)) {
+        rank -= page->CountAt(slot);
+        ++slot;
       }
+      cur_page = ReadNode(page->ValueAt(slot), depth, &cur_guard);
     }
-    next_page_id = next_page->GetNextPageId();
+    if (rank >= cur_page->GetSize()) {
+      return Iterator();
+    }
+    it = Iterator(bpm_, std::move(cur_guard), rank);
   }
-  return false;
+  if (it.IsEnd() || degraded_comparator_(prefix, it.Key()) != 0) {
+    return Iterator();
+  }
+  return it;
 }
 
 /*****************************************************************************
@@ -182,188 +371,791 @@ auto BPLUSTREE_TYPE::GetAllValue(const KeyType& key,
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::Insert(const KeyType& key,
                             const ValueType& value) -> bool {
+  if (!InsertImpl(key, value, false)) {
+    return false;
+  }
+  AddToBloomFilter(key);
+  return true;
+}
+
+/**
+ * @brief Insert key & value pair, or overwrite the value if key already exists
+ *
+ * An existing entry is overwritten in place within the same descent, so only
+ * its leaf page gets dirty.
+ *
+ * @return true if a new entry was inserted, false if an existing one was
+ * overwritten
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::Upsert(const KeyType& key,
+                            const ValueType& value) -> bool {
+  if (!InsertImpl(key, value, true)) {
+    return false;
+  }
+  AddToBloomFilter(key);
+  return true;
+}
+
+/**
+ * @brief Insert into the leaf of hint_ without descending
+ *
+ * Only taken when key lies between the separators of the leaf, is not stored
+ * yet and fits without a split. Counted trees add the entry to the counts
+ * along the remembered path.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::InsertAtHint(const KeyType& key,
+                                  const ValueType& value) -> bool {
+  if (hint_.leaf_page_id_ == INVALID_PAGE_ID ||
+      (hint_.lower_.has_value() && comparator_(key, *hint_.lower_) < 0) ||
+      (hint_.upper_.has_value() && comparator_(key, *hint_.upper_) >= 0)) {
+    return false;
+  }
+  auto leaf_guard = WriteNode(hint_.leaf_page_id_);
+  auto leaf_page = leaf_guard.template AsMut<LeafPage>();
+  auto position = leaf_page->KeyIndex(key, comparator_);
+  if ((position < leaf_page->GetSize() &&
+       comparator_(leaf_page->KeyAt(position), key) == 0) ||
+      !leaf_page->CanHold(value)) {
+    return false;
+  }
+  leaf_page->InsertAt(position, key, value);
+  if (counted_) {
+    for (int i = 0; i < hint_.path_.size(); ++i) {
+      auto guard = WriteNode(hint_.path_[i]);
+      auto page = guard.template AsMut<InternalPage>();
+      page->SetCountAt(hint_.slots_[i], page->CountAt(hint_.slots_[i]) + 1);
+    }
+  }
+  return true;
+}
+
+/**
+ * A leaf split by an append at its end keeps APPEND_SPLIT_PERCENT of the
+ * load instead of half of it, so keys growing within a prefix leave nearly
+ * full leaves behind.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::InsertImpl(const KeyType& key, const ValueType& value,
+                                bool overwrite) -> bool {
+  if (InsertAtHint(key, value)) {
+    return true;
+  }
   // Declaration of context instance.
   Context ctx;
   auto root_id = GetRootPageId();
-  ctx.header_page_ = bpm_->WritePage(header_page_id_);
   if (root_id == INVALID_PAGE_ID) {
-    auto head_page = ctx.header_page_.value().AsMut<BPlusTreeHeaderPage>();
-    head_page->root_page_id_ = bpm_->NewPage();
-    auto cur_guard = bpm_->WritePage(head_page->root_page_id_);
-    auto cur_page = cur_guard.AsMut<LeafPage>();
+    SetRootPageId(bpm_->NewPage());
+    auto cur_guard = WriteNode(root_page_id_);
+    auto cur_page = cur_guard.template AsMut<LeafPage>();
     cur_page->Init(leaf_max_size_);
-    cur_page->ChangeSizeBy(1);
-    cur_page->SetKeyAt(0, key);
-    cur_page->SetRidAt(0, value);
+    cur_page->InsertAt(0, key, value);
     cur_page->SetNextPageId(-1);
     return true;
   }
   ctx.root_page_id_ = root_id;
-  ctx.write_set_.push_back(bpm_->WritePage(ctx.root_page_id_));
+  ctx.write_set_.push_back(WriteNode(ctx.root_page_id_));
 
+  std::optional<KeyType> lower;
+  std::optional<KeyType> upper;
   while (true) {
-    auto cur_page = ctx.write_set_.back().AsMut<BPlusTreePage>();
+    auto cur_page = ctx.write_set_.back().As<BPlusTreePage>();
     if (cur_page->IsLeafPage()) {
       break;
     }
-    auto page = ctx.write_set_.back().AsMut<InternalPage>();
-    auto page_size = page->GetSize();
-    auto slot = page_size - 1;
-    for (int i = 1; i < page_size; ++i) {
-      if (comparator_(page->KeyAt(i), key) >= 0) {
-        slot = i;
-        break;
-      }
+    auto page = ctx.write_set_.back().As<InternalPage>();
+    auto slot = page->LookUp(key, comparator_);
+    if (slot > 0) {
+      lower = page->KeyAt(slot);
     }
-    if (comparator_(key, page->KeyAt(slot)) < 0) {
-      --slot;
+    if (slot + 1 < page->GetSize()) {
+      upper = page->KeyAt(slot + 1);
     }
-    ctx.write_set_.push_back(bpm_->WritePage(page->ValueAt(slot)));
+    ctx.slot_set_.push_back(slot);
+    ctx.write_set_.push_back(WriteNode(page->ValueAt(slot)));
   }
 
-  auto leaf_page = ctx.write_set_.back().AsMut<LeafPage>();
-
-  if (leaf_page->GetSize() < leaf_max_size_) {
-    int size = leaf_page->GetSize();
-    if (comparator_(key, leaf_page->KeyAt(0)) < 0) {
-      for (int i = size - 1; i >= 0; --i) {
-        leaf_page->SetKeyAt(i + 1, leaf_page->KeyAt(i));
-        leaf_page->SetRidAt(i + 1, leaf_page->RidAt(i));
-      }
-      leaf_page->SetSize(size + 1);
-      leaf_page->SetKeyAt(0, key);
-      leaf_page->SetRidAt(0, value);
-      return true;
+  auto leaf_view = ctx.write_set_.back().As<LeafPage>();
+  int size = leaf_view->GetSize();
+  auto position = leaf_view->KeyIndex(key, comparator_);
+  bool replaced = false;
+  if (position < size && comparator_(leaf_view->KeyAt(position), key) == 0) {
+    if (!overwrite) {
+      return false;
     }
-    for (int i = size - 1; i >= 0; --i) {
-      if (comparator_(key, leaf_page->KeyAt(i)) >= 0) {
-        if (comparator_(leaf_page->KeyAt(i), key) == 0) {
-          return false;
-        }
-        for (int j = size - 1; j >= i + 1; --j) {
-          leaf_page->SetKeyAt(j + 1, leaf_page->KeyAt(j));
-          leaf_page->SetRidAt(j + 1, leaf_page->RidAt(j));
-        }
-        leaf_page->SetSize(size + 1);
-        leaf_page->SetKeyAt(i + 1, key);
-        leaf_page->SetRidAt(i + 1, value);
-        return true;
-      }
+    auto leaf_page = ctx.write_set_.back().AsMut<LeafPage>();
+    if (leaf_page->SetRidAt(position, value)) {
+      return false;
     }
-    return false;
-  }
-
-  sjtu::vector<KeyType> leaf_keys;
-  sjtu::vector<ValueType> leaf_values;
-  for (int i = 0; i < leaf_max_size_; ++i) {
-    leaf_keys.push_back(leaf_page->KeyAt(i));
-    leaf_values.push_back(leaf_page->RidAt(i));
-  }
-  if (comparator_(key, leaf_page->KeyAt(0)) < 0) {
-    leaf_keys.insert(leaf_keys.begin(), key);
-    leaf_values.insert(leaf_values.begin(), value);
+    // A longer payload that no longer fits into its slotted leaf is
+    // inserted again through the split below.
+    leaf_page->RemoveAt(position);
+    replaced = true;
   } else {
-    for (int i = leaf_max_size_ - 1; i >= 0; --i) {
-      if (comparator_(key, leaf_keys[i]) >= 0) {
-        if (comparator_(leaf_keys[i], key) == 0) {
-          return false;
-        }
-        leaf_keys.insert(leaf_keys.begin() + i + 1, key);
-        leaf_values.insert(leaf_values.begin() + i + 1, value);
-        break;
-      }
+    AddToPathCounts(ctx, 1);
+  }
+  auto leaf_page = ctx.write_set_.back().AsMut<LeafPage>();
+  if (leaf_page->CanHold(value)) {
+    leaf_page->InsertAt(position, key, value);
+    hint_.leaf_page_id_ = ctx.write_set_.back().GetPageId();
+    hint_.lower_ = lower;
+    hint_.upper_ = upper;
+    hint_.path_.clear();
+    for (int i = 0; i < ctx.slot_set_.size(); ++i) {
+      hint_.path_.push_back(ctx.write_set_[i].GetPageId());
     }
+    hint_.slots_ = ctx.slot_set_;
+    return !replaced;
   }
+  hint_.Clear();
+
+  // Split without staging the entries: pick the split point of the page with
+  // the new entry at position, move the tail, then insert into its half.
+  int leaf_size = leaf_page->GetSize();
+  int total_load = leaf_page->Load() + LeafPage::EntryCost(value);
+  int value_cost = LeafPage::EntryCost(value);
+  int target = position == leaf_size
+                   ? total_load * APPEND_SPLIT_PERCENT / 100
+                   : (total_load + 1) / 2;
+  auto remain_leaf_size = LeafSplitPoint(
+      leaf_size + 1,
+      [&](int i) {
+        return i == position ? value_cost
+                             : leaf_page->EntryCostAt(i < position ? i : i - 1);
+      },
+      target, leaf_page->Capacity());
   auto new_leaf_page_id = bpm_->NewPage();
-  auto new_leaf_page_guard = bpm_->WritePage(new_leaf_page_id);
-  auto new_leaf_page = new_leaf_page_guard.AsMut<LeafPage>();
+  auto new_leaf_page_guard = WriteNode(new_leaf_page_id);
+  auto new_leaf_page = new_leaf_page_guard.template AsMut<LeafPage>();
   new_leaf_page->Init(leaf_max_size_);
   new_leaf_page->SetNextPageId(leaf_page->GetNextPageId());
+  new_leaf_page->SetPrevPageId(ctx.write_set_.back().GetPageId());
+  RelinkPrevPage(leaf_page->GetNextPageId(), new_leaf_page_id);
   leaf_page->SetNextPageId(new_leaf_page_id);
-
-  auto new_leaf_size = (leaf_max_size_ + 1) / 2;
-  auto remain_leaf_size = leaf_max_size_ + 1 - new_leaf_size;
-  new_leaf_page->SetSize(new_leaf_size);
-  leaf_page->SetSize(remain_leaf_size);
-
-  for (int i = 0; i < new_leaf_size; ++i) {
-    new_leaf_page->SetKeyAt(i, leaf_keys[remain_leaf_size + i]);
-    new_leaf_page->SetRidAt(i, leaf_values[remain_leaf_size + i]);
-  }
-  for (int i = 0; i < remain_leaf_size; ++i) {
-    leaf_page->SetKeyAt(i, leaf_keys[i]);
-    leaf_page->SetRidAt(i, leaf_values[i]);
+  if (position < remain_leaf_size) {
+    leaf_page->MoveTailTo(new_leaf_page, remain_leaf_size - 1);
+    leaf_page->InsertAt(position, key, value);
+  } else {
+    leaf_page->MoveTailTo(new_leaf_page, remain_leaf_size);
+    new_leaf_page->InsertAt(position - remain_leaf_size, key, value);
   }
+  auto new_leaf_size = new_leaf_page->GetSize();
+  auto separator = new_leaf_page->KeyAt(0);
+  new_leaf_page_guard.Drop();
 
   // recursively insert in parent
-  auto page_id_to_insert = new_leaf_page_id;
-  auto key_to_insert = leaf_keys[remain_leaf_size];
   auto remain_page_id = ctx.write_set_.back().GetPageId();
   ctx.write_set_.pop_back();
+  InsertIntoParent(ctx, remain_page_id, remain_leaf_size, separator,
+                   new_leaf_page_id, new_leaf_size);
+  return !replaced;
+}
 
+/**
+ * @brief Link a freshly split page into its parent
+ *
+ * ctx.write_set_ holds the guards of the ancestors of the split page, root
+ * first; the split page itself must already have been released. Splits
+ * propagate upwards as needed and may grow a new root.
+ *
+ * In counted trees the entry counts of both halves are known to the caller,
+ * the counts of the ancestors above them do not change.
+ *
+ * @param remain_page_id page that was split, it keeps the lower half
+ * @param remain_count number of entries left under remain_page_id
+ * @param key_to_insert first key stored under page_id_to_insert
+ * @param page_id_to_insert new right sibling of remain_page_id
+ * @param new_count number of entries under page_id_to_insert
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::InsertIntoParent(Context& ctx, page_id_t remain_page_id,
+                                      int remain_count, KeyType key_to_insert,
+                                      page_id_t page_id_to_insert,
+                                      int new_count) {
   while (!ctx.write_set_.empty()) {
     auto cur_page = ctx.write_set_.back().AsMut<InternalPage>();
     auto position_to_insert = cur_page->ValueIndex(remain_page_id);
     auto cur_size = cur_page->GetSize();
+    cur_page->SetCountAt(position_to_insert, remain_count);
     if (cur_size < internal_max_size_) {
-      for (int i = cur_size - 1; i > position_to_insert; --i) {
-        cur_page->SetKeyAt(i + 1, cur_page->KeyAt(i));
-        cur_page->SetValueAt(i + 1, cur_page->ValueAt(i));
-      }
-      cur_page->SetSize(cur_size + 1);
-      cur_page->SetKeyAt(position_to_insert + 1, key_to_insert);
-      cur_page->SetValueAt(position_to_insert + 1, page_id_to_insert);
-      return true;
-    }
-
-    sjtu::vector<KeyType> internal_key;
-    sjtu::vector<page_id_t> internal_value;
-    for (int i = 0; i < internal_max_size_; ++i) {
-      internal_key.push_back(cur_page->KeyAt(i));
-      internal_value.push_back(cur_page->ValueAt(i));
+      cur_page->InsertAt(position_to_insert + 1, key_to_insert,
+                         page_id_to_insert, new_count);
+      return;
     }
-    internal_key.insert(internal_key.begin() + position_to_insert + 1,
-                        key_to_insert);
-    internal_value.insert(internal_value.begin() + position_to_insert + 1,
-                          page_id_to_insert);
 
+    // Move the upper half of the full page out first, then insert the new
+    // entry into whichever half it falls in.
     auto new_internal_size = (internal_max_size_ + 1) / 2;
     auto remain_internal_size = (internal_max_size_ + 1) - new_internal_size;
 
     auto new_internal_page_id = bpm_->NewPage();
-    auto new_internal_guard = bpm_->WritePage(new_internal_page_id);
-    auto new_internal_page = new_internal_guard.AsMut<InternalPage>();
-    new_internal_page->Init(internal_max_size_);
-    new_internal_page->SetSize(new_internal_size);
-    cur_page->SetSize(remain_internal_size);
-    for (int i = 0; i < new_internal_size; ++i) {
-      new_internal_page->SetKeyAt(i, internal_key[remain_internal_size + i]);
-      new_internal_page->
-          SetValueAt(i, internal_value[remain_internal_size + i]);
-    }
-    for (int i = 0; i < remain_internal_size; ++i) {
-      cur_page->SetKeyAt(i, internal_key[i]);
-      cur_page->SetValueAt(i, internal_value[i]);
+    auto new_internal_guard = WriteNode(new_internal_page_id);
+    auto new_internal_page = new_internal_guard.template AsMut<InternalPage>();
+    new_internal_page->Init(internal_max_size_, counted_);
+    if (position_to_insert + 1 < remain_internal_size) {
+      cur_page->MoveTailTo(new_internal_page, remain_internal_size - 1);
+      cur_page->InsertAt(position_to_insert + 1, key_to_insert,
+                         page_id_to_insert, new_count);
+    } else {
+      cur_page->MoveTailTo(new_internal_page, remain_internal_size);
+      new_internal_page->InsertAt(position_to_insert + 1 - remain_internal_size,
+                                  key_to_insert, page_id_to_insert, new_count);
     }
+    new_count = new_internal_page->CountSum();
+    remain_count = cur_page->CountSum();
     page_id_to_insert = new_internal_page_id;
-    key_to_insert = internal_key[remain_internal_size];
+    key_to_insert = new_internal_page->KeyAt(0);
 
     remain_page_id = ctx.write_set_.back().GetPageId();
     ctx.write_set_.pop_back();
   }
 
   auto new_root_id = bpm_->NewPage();
-  auto new_root_guard = bpm_->WritePage(new_root_id);
-  auto new_root_page = new_root_guard.AsMut<InternalPage>();
-  new_root_page->Init(internal_max_size_);
+  auto new_root_guard = WriteNode(new_root_id);
+  auto new_root_page = new_root_guard.template AsMut<InternalPage>();
+  new_root_page->Init(internal_max_size_, counted_);
   new_root_page->SetSize(2);
   new_root_page->SetKeyAt(1, key_to_insert);
   new_root_page->SetValueAt(0, ctx.root_page_id_);
   new_root_page->SetValueAt(1, page_id_to_insert);
-  ctx.header_page_->AsMut<BPlusTreeHeaderPage>()->root_page_id_ = new_root_id;
+  new_root_page->SetCountAt(0, remain_count);
+  new_root_page->SetCountAt(1, new_count);
+  SetRootPageId(new_root_id);
+}
+
+/**
+ * @brief Size below which Remove rebalances page, by underflow policy
+ *
+ * A lazy internal page is kept as long as it has two children. Siblings are
+ * only borrowed from while they stay above their minimum size, so merging a
+ * page below the watermark still fits into one page.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::UnderflowSize(const BPlusTreePage* page) const -> int {
+  if (underflow_policy_ == UnderflowPolicy::Eager) {
+    return page->GetMinSize();
+  }
+  int watermark = page->GetMaxSize() * LAZY_MERGE_PERCENT / 100;
+  int least = page->IsLeafPage() ? 1 : 2;
+  return watermark < least ? least : watermark;
+}
+
+/**
+ * @brief Load below which Remove rebalances leaf, by underflow policy
+ *
+ * Same watermarks as UnderflowSize, measured in the leaf's own units.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::LeafUnderflowLoad(const LeafPage* leaf) const -> int {
+  if (underflow_policy_ == UnderflowPolicy::Eager) {
+    return leaf->MinLoad();
+  }
+  int watermark = leaf->Capacity() * LAZY_MERGE_PERCENT / 100;
+  return watermark < 1 ? 1 : watermark;
+}
+
+// Capacity of a leaf page of this tree, see LeafPage::Capacity.
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::LeafCapacity() const -> int {
+  return LeafPage::SLOTTED ? LEAF_PAGE_DATA_SIZE : leaf_max_size_;
+}
+
+/**
+ * @brief Choose where to split a run of leaf entries into two pages
+ *
+ * The lower page takes the longest prefix whose load stays within target,
+ * then grows until the rest fits into one page. Both pages keep at least one
+ * entry.
+ *
+ * @param entry_cnt number of entries in the run
+ * @param entry_cost EntryCost of the i-th entry of the run in key order
+ * @param target load the lower page should end up with
+ * @param capacity capacity of a leaf page
+ * @return number of entries kept by the lower page
+ */
+INDEX_TEMPLATE_ARGUMENTS
+template <typename EntryCost>
+auto BPLUSTREE_TYPE::LeafSplitPoint(int entry_cnt, EntryCost&& entry_cost,
+                                    int target, int capacity) const -> int {
+  int total = 0;
+  for (int i = 0; i < entry_cnt; ++i) {
+    total += entry_cost(i);
+  }
+  int split = 0;
+  int load = 0;
+  while (split < entry_cnt - 1 &&
+         (split == 0 || load + entry_cost(split) <= target)) {
+    load += entry_cost(split);
+    ++split;
+  }
+  while (split < entry_cnt - 1 && total - load > capacity) {
+    load += entry_cost(split);
+    ++split;
+  }
+  return split;
+}
+
+/**
+ * @brief Point the prev pointer of leaf page_id at prev_page_id
+ *
+ * Used when the leaf before page_id changes because of a split or merge,
+ * does nothing when page_id is INVALID_PAGE_ID (end of the leaf chain).
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::RelinkPrevPage(page_id_t page_id,
+                                    page_id_t prev_page_id) {
+  if (page_id == INVALID_PAGE_ID) {
+    return;
+  }
+  auto guard = WriteNode(page_id);
+  guard.template AsMut<LeafPage>()->SetPrevPageId(prev_page_id);
+}
+
+/**
+ * @brief Add delta to the entry count of every child slot on the path held by
+ * ctx, a no-op unless the tree is counted
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::AddToPathCounts(Context& ctx, int delta) {
+  if (!counted_) {
+    return;
+  }
+  for (int i = 0; i < ctx.slot_set_.size(); ++i) {
+    auto page = ctx.write_set_[i].AsMut<InternalPage>();
+    auto slot = ctx.slot_set_[i];
+    page->SetCountAt(slot, page->CountAt(slot) + delta);
+  }
+}
+
+/**
+ * @return number of entries less than prefix under the degraded comparator,
+ * or not greater than it if inclusive; only valid on counted trees
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::CountBefore(const KeyType& prefix, bool inclusive)
+  -> int {
+  auto root_id = GetRootPageId();
+  if (root_id == INVALID_PAGE_ID) {
+    return 0;
+  }
+  int count = 0;
+  ReadPageGuard cur_guard;
+  auto cur_page = ReadNode(root_id, 0, &cur_guard);
+  for (int depth = 1; !cur_page->IsLeafPage(); ++depth) {
+    auto page = static_cast<const InternalPage*>(cur_page);
+    auto slot = inclusive ? page->LookUp(prefix, degraded_comparator_)
+                          : page->LookUpBefore(prefix, degraded_comparator_);
+    for (int i = 0; i < slot; ++i) {
+      count += page->CountAt(i);
+    }
+    cur_page = ReadNode(page->ValueAt(slot), depth, &cur_guard);
+  }
+  auto leaf_page = static_cast<const LeafPage*>(cur_page);
+  return count + (inclusive
+                    ? leaf_page->KeyUpperIndex(prefix, degraded_comparator_)
+                    : leaf_page->KeyIndex(prefix, degraded_comparator_));
+}
+
+/**
+ * @return number of entries a page with max_size slots keeps when filled to
+ * fill_percent, never below its minimum size
+ */
+static auto BulkFillSize(int max_size, int fill_percent = BULK_FILL_PERCENT) -> int {
+  int fill = max_size * fill_percent / 100;
+  int min_size = (max_size + 1) / 2;
+  return fill < min_size ? min_size : fill;
+}
+
+/**
+ * @return number of pages to spread n entries over so that every page holds
+ * at least its fill size and none holds more than max_size
+ */
+static auto BulkPageCount(int n, int max_size,
+                          int fill_percent = BULK_FILL_PERCENT) -> int {
+  int pages = n / BulkFillSize(max_size, fill_percent);
+  if (pages == 0) {
+    pages = 1;
+  }
+  int least = (n + max_size - 1) / max_size;
+  return pages < least ? least : pages;
+}
+
+/**
+ * @brief Insert a batch of key & value pairs sorted by key
+ *
+ * Each round descends once to the leaf that owns keys[next], merges in every
+ * following batch key that still falls below the leaf's upper separator and
+ * splits the leaf at most once, leaving the lower page BULK_FILL_PERCENT full
+ * so that the rest of the batch lands in the new right sibling.
+ *
+ * @param keys keys in non-decreasing order; keys already in the tree and
+ * repeated batch keys are skipped
+ * @param values values matching keys one by one
+ * @return number of entries inserted
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::InsertBatch(const sjtu::vector<KeyType>& keys,
+                                 const sjtu::vector<ValueType>& values)
+  -> int {
+  int batch_size = keys.size();
+  int inserted = 0;
+  int next = 0;
+  hint_.Clear();
+  while (next < batch_size) {
+    auto root_id = GetRootPageId();
+    if (root_id == INVALID_PAGE_ID) {
+      inserted += InsertImpl(keys[next], values[next], false) ? 1 : 0;
+      ++next;
+      continue;
+    }
+    Context ctx;
+    ctx.root_page_id_ = root_id;
+    ctx.write_set_.push_back(WriteNode(root_id));
+    std::optional<KeyType> fence;
+    while (true) {
+      auto cur_page = ctx.write_set_.back().As<BPlusTreePage>();
+      if (cur_page->IsLeafPage()) {
+        break;
+      }
+      auto page = ctx.write_set_.back().As<InternalPage>();
+      auto slot = page->LookUp(keys[next], comparator_);
+      if (slot + 1 < page->GetSize()) {
+        fence = page->KeyAt(slot + 1);
+      }
+      ctx.slot_set_.push_back(slot);
+      ctx.write_set_.push_back(WriteNode(page->ValueAt(slot)));
+    }
+
+    // merge the existing entries with the batch keys owned by this leaf
+    auto leaf_view = ctx.write_set_.back().As<LeafPage>();
+    int size = leaf_view->GetSize();
+    int capacity = leaf_view->Capacity();
+    int leaf_fill = BulkFillSize(capacity);
+    int room = capacity + leaf_fill - leaf_view->Load();
+    sjtu::vector<KeyType> merged_keys;
+    sjtu::vector<ValueType> merged_values;
+    int taken = 0;
+    int taken_load = 0;
+    int index = 0;
+    while (next < batch_size &&
+           taken_load + LeafPage::EntryCost(values[next]) <= room &&
+           (!fence.has_value() || comparator_(keys[next], *fence) < 0)) {
+      const auto& key = keys[next];
+      if (next > 0 && comparator_(keys[next - 1], key) == 0) {
+        ++next;
+        continue;
+      }
+      while (index < size && comparator_(leaf_view->KeyAt(index), key) < 0) {
+        merged_keys.push_back(leaf_view->KeyAt(index));
+        merged_values.push_back(leaf_view->RidAt(index));
+        ++index;
+      }
+      if (index < size && comparator_(leaf_view->KeyAt(index), key) == 0) {
+        ++next;
+        continue;
+      }
+      merged_keys.push_back(key);
+      merged_values.push_back(values[next]);
+      ++taken;
+      taken_load += LeafPage::EntryCost(values[next]);
+      ++next;
+    }
+    if (taken == 0) {
+      continue;
+    }
+    AddToPathCounts(ctx, taken);
+    for (; index < size; ++index) {
+      merged_keys.push_back(leaf_view->KeyAt(index));
+      merged_values.push_back(leaf_view->RidAt(index));
+    }
+    inserted += taken;
+
+    int total = merged_keys.size();
+    int total_load = leaf_view->Load() + taken_load;
+    auto leaf_page = ctx.write_set_.back().AsMut<LeafPage>();
+    if (total_load <= capacity) {
+      leaf_page->Assign(merged_keys, merged_values, 0, total);
+      continue;
+    }
+
+    auto target = total_load - leaf_page->MinLoad();
+    if (target > leaf_fill) {
+      target = leaf_fill;
+    }
+    auto remain_leaf_size = LeafSplitPoint(
+        total, [&](int i) { return LeafPage::EntryCost(merged_values[i]); },
+        target, capacity);
+    auto new_leaf_size = total - remain_leaf_size;
+    auto new_leaf_page_id = bpm_->NewPage();
+    auto new_leaf_page_guard = WriteNode(new_leaf_page_id);
+    auto new_leaf_page = new_leaf_page_guard.template AsMut<LeafPage>();
+    new_leaf_page->Init(leaf_max_size_);
+    new_leaf_page->SetNextPageId(leaf_page->GetNextPageId());
+    new_leaf_page->SetPrevPageId(ctx.write_set_.back().GetPageId());
+    RelinkPrevPage(leaf_page->GetNextPageId(), new_leaf_page_id);
+    leaf_page->SetNextPageId(new_leaf_page_id);
+    new_leaf_page->Assign(merged_keys, merged_values, remain_leaf_size,
+                          new_leaf_size);
+    leaf_page->Assign(merged_keys, merged_values, 0, remain_leaf_size);
+    new_leaf_page_guard.Drop();
+
+    auto remain_page_id = ctx.write_set_.back().GetPageId();
+    ctx.write_set_.pop_back();
+    InsertIntoParent(ctx, remain_page_id, remain_leaf_size,
+                     merged_keys[remain_leaf_size], new_leaf_page_id,
+                     new_leaf_size);
+  }
+  if (bloom_.IsEnabled()) {
+    for (int i = 0; i < batch_size; ++i) {
+      AddToBloomFilter(keys[i]);
+    }
+  }
+  return inserted;
+}
+
+/**
+ * @brief Build the tree bottom-up from sorted key & value pairs
+ *
+ * Leaves are written left to right and chained as they go, then each internal
+ * level is built over the first keys of the level below, so every page is
+ * written exactly once. Pages are filled to about BULK_FILL_PERCENT, entries
+ * are spread evenly so the last page of a level is not left underfull.
+ *
+ * @param keys keys in strictly increasing order
+ * @param values values matching keys one by one
+ * @return false if the tree is not empty, in which case nothing is loaded
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::BulkLoad(const sjtu::vector<KeyType>& keys,
+                              const sjtu::vector<ValueType>& values) -> bool {
+  if (root_page_id_ != INVALID_PAGE_ID) {
+    return false;
+  }
+  int entry_cnt = keys.size();
+  if (entry_cnt == 0) {
+    return true;
+  }
+
+  sjtu::vector<KeyType> level_keys;
+  sjtu::vector<page_id_t> level_pages;
+  sjtu::vector<int> level_counts;
+  int load_left = 0;
+  for (int i = 0; i < entry_cnt; ++i) {
+    load_left += LeafPage::EntryCost(values[i]);
+  }
+  int capacity = LeafCapacity();
+  int page_cnt = BulkPageCount(load_left, capacity);
+  WritePageGuard prev_guard;
+  int begin = 0;
+  for (int i = 0; begin < entry_cnt; ++i) {
+    // spread the remaining load evenly over the remaining pages
+    int pages_left = i < page_cnt ? page_cnt - i : 1;
+    int target = (load_left + pages_left - 1) / pages_left;
+    int size = 0;
+    int load = 0;
+    while (begin + size < entry_cnt) {
+      int cost = LeafPage::EntryCost(values[begin + size]);
+      if (size > 0 && (load >= target || load + cost > capacity)) {
+        break;
+      }
+      load += cost;
+      ++size;
+    }
+    load_left -= load;
+    auto page_id = bpm_->NewPage();
+    auto guard = WriteNode(page_id);
+    auto leaf_page = guard.template AsMut<LeafPage>();
+    leaf_page->Init(leaf_max_size_);
+    leaf_page->SetNextPageId(INVALID_PAGE_ID);
+    leaf_page->Assign(keys, values, begin, size);
+    if (i > 0) {
+      leaf_page->SetPrevPageId(level_pages.back());
+      prev_guard.AsMut<LeafPage>()->SetNextPageId(page_id);
+    }
+    prev_guard = std::move(guard);
+    level_keys.push_back(keys[begin]);
+    level_pages.push_back(page_id);
+    level_counts.push_back(size);
+    begin += size;
+  }
+  prev_guard.Drop();
+
+  SetRootPageId(BuildInternalLevels(&level_keys, &level_pages, &level_counts));
+  if (bloom_.IsEnabled()) {
+    for (int i = 0; i < entry_cnt; ++i) {
+      AddToBloomFilter(keys[i]);
+    }
+  }
   return true;
 }
 
+/**
+ * @brief Build the internal levels over a level of pages, bottom-up
+ *
+ * Each page is filled to about fill_percent, the first key of each child
+ * becomes its separator.
+ *
+ * @param level_keys first key of each page of the bottom level
+ * @param level_pages the pages, left to right
+ * @param level_counts entries under each page
+ * @return page id of the root
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::BuildInternalLevels(sjtu::vector<KeyType>* level_keys,
+                                         sjtu::vector<page_id_t>* level_pages,
+                                         sjtu::vector<int>* level_counts,
+                                         int fill_percent) -> page_id_t {
+  while (level_pages->size() > 1) {
+    int child_cnt = level_pages->size();
+    int page_cnt = BulkPageCount(child_cnt, internal_max_size_, fill_percent);
+    sjtu::vector<KeyType> upper_keys;
+    sjtu::vector<page_id_t> upper_pages;
+    sjtu::vector<int> upper_counts;
+    int begin = 0;
+    for (int i = 0; i < page_cnt; ++i) {
+      int size = child_cnt / page_cnt + (i < child_cnt % page_cnt ? 1 : 0);
+      auto page_id = bpm_->NewPage();
+      auto guard = WriteNode(page_id);
+      auto internal_page = guard.template AsMut<InternalPage>();
+      internal_page->Init(internal_max_size_, counted_);
+      internal_page->SetSize(size);
+      int count = 0;
+      for (int j = 0; j < size; ++j) {
+        internal_page->SetKeyAt(j, (*level_keys)[begin + j]);
+        internal_page->SetValueAt(j, (*level_pages)[begin + j]);
+        internal_page->SetCountAt(j, (*level_counts)[begin + j]);
+        count += (*level_counts)[begin + j];
+      }
+      upper_keys.push_back((*level_keys)[begin]);
+      upper_pages.push_back(page_id);
+      upper_counts.push_back(count);
+      begin += size;
+    }
+    *level_keys = std::move(upper_keys);
+    *level_pages = std::move(upper_pages);
+    *level_counts = std::move(upper_counts);
+  }
+  return (*level_pages)[0];
+}
+
+/**
+ * @brief Rewrite the tree into index_name_ + "_compact", then move it over
+ * the index file
+ *
+ * Leaves are streamed from the old leaf chain into new pages, spreading the
+ * load evenly as BulkLoad does, and the internal levels are rebuilt over
+ * them. The new file replaces the old one by a rename once it is complete,
+ * so a crash leaves either the old or the compacted tree behind.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::Compact(int fill_percent) {
+  // open snapshots read pages of the old file
+  if (!snapshots_.empty()) {
+    return;
+  }
+  auto bpm_max_size = bpm_->Size();
+  auto compact_name = index_name_ + "_compact";
+  std::filesystem::remove(compact_name);
+  hint_.Clear();
+  // pinned pages belong to the old pool
+  for (size_t i = 0; i < pinned_.size(); ++i) {
+    pinned_[i].reset();
+  }
+
+  auto* old_bpm = bpm_;
+  page_id_t old_page_id = root_page_id_;
+  int load_left = 0;
+  if (old_page_id != INVALID_PAGE_ID) {
+    while (true) {
+      auto guard = old_bpm->ReadPage(old_page_id);
+      auto page = guard.template As<BPlusTreePage>();
+      if (page->IsLeafPage()) {
+        break;
+      }
+      old_page_id = guard.template As<InternalPage>()->ValueAt(0);
+    }
+    for (auto page_id = old_page_id; page_id != INVALID_PAGE_ID;) {
+      auto guard = old_bpm->ReadPage(page_id);
+      auto leaf_page = guard.template As<LeafPage>();
+      load_left += leaf_page->Load();
+      page_id = leaf_page->GetNextPageId();
+    }
+  }
+
+  bpm_ = new BufferPoolManager(bpm_max_size, compact_name);
+  header_page_id_ = bpm_->NewPage();
+  sjtu::vector<KeyType> level_keys;
+  sjtu::vector<page_id_t> level_pages;
+  sjtu::vector<int> level_counts;
+  int capacity = LeafCapacity();
+  int page_cnt = BulkPageCount(load_left, capacity, fill_percent);
+  WritePageGuard new_guard;
+  LeafPage* new_leaf_page = nullptr;
+  int target = 0;
+  while (old_page_id != INVALID_PAGE_ID) {
+    auto old_guard = old_bpm->ReadPage(old_page_id);
+    auto old_leaf_page = old_guard.template As<LeafPage>();
+    for (int i = 0; i < old_leaf_page->GetSize(); ++i) {
+      auto value = old_leaf_page->RidAt(i);
+      int cost = LeafPage::EntryCost(value);
+      if (new_leaf_page == nullptr ||
+          (new_leaf_page->GetSize() > 0 &&
+           (new_leaf_page->Load() >= target || new_leaf_page->Load() + cost > capacity))) {
+        if (new_leaf_page != nullptr) {
+          load_left -= new_leaf_page->Load();
+        }
+        // spread the remaining load evenly over the remaining pages
+        int pages_left = static_cast<int>(level_pages.size()) < page_cnt
+                           ? page_cnt - static_cast<int>(level_pages.size())
+                           : 1;
+        target = (load_left + pages_left - 1) / pages_left;
+        auto page_id = bpm_->NewPage();
+        auto guard = WriteNode(page_id);
+        auto leaf_page = guard.template AsMut<LeafPage>();
+        leaf_page->Init(leaf_max_size_);
+        leaf_page->SetNextPageId(INVALID_PAGE_ID);
+        leaf_page->SetPrevPageId(INVALID_PAGE_ID);
+        if (new_leaf_page != nullptr) {
+          leaf_page->SetPrevPageId(level_pages.back());
+          new_leaf_page->SetNextPageId(page_id);
+        }
+        new_guard = std::move(guard);
+        new_leaf_page = leaf_page;
+        level_keys.push_back(old_leaf_page->KeyAt(i));
+        level_pages.push_back(page_id);
+        level_counts.push_back(0);
+      }
+      new_leaf_page->InsertAt(new_leaf_page->GetSize(), old_leaf_page->KeyAt(i), value);
+      ++level_counts.back();
+    }
+    old_page_id = old_leaf_page->GetNextPageId();
+  }
+  new_guard.Drop();
+  delete old_bpm;
+
+  page_id_t root_page_id = INVALID_PAGE_ID;
+  if (!level_pages.empty()) {
+    root_page_id = BuildInternalLevels(&level_keys, &level_pages, &level_counts,
+                                       fill_percent);
+  }
+  {
+    auto guard = bpm_->WritePage(header_page_id_);
+    auto header_page = guard.template AsMut<BPlusTreeHeaderPage>();
+    header_page->root_page_id_ = root_page_id;
+    header_page->counted_ = counted_ ? 1 : 0;
+    // the filter still holds the same keys, it is saved into the new file
+    // by the destructor
+    header_page->next_page_id_ = bpm_->GetNextPageId();
+  }
+  auto next_page_id = bpm_->GetNextPageId();
+  delete bpm_;
+  std::filesystem::rename(compact_name, index_name_);
+  bpm_ = new BufferPoolManager(bpm_max_size, index_name_);
+  bpm_->SetNextPageId(next_page_id);
+  root_page_id_ = root_page_id;
+}
+
 /*****************************************************************************
  * REMOVE
  *****************************************************************************/
@@ -378,68 +1170,58 @@ auto BPLUSTREE_TYPE::Insert(const KeyType& key,
  */
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::Remove(const KeyType& key) {
+  if (!MayContain(key)) {
+    return;
+  }
+  if (bloom_.IsEnabled()) {
+    bloom_.NoteRemove();
+  }
   // Declaration of context instance.
   Context ctx;
   auto root_id = GetRootPageId();
   if (root_id == INVALID_PAGE_ID) {
     return;
   }
-  ctx.header_page_ = bpm_->WritePage(header_page_id_);
   ctx.root_page_id_ = root_id;
-  ctx.write_set_.push_back(bpm_->WritePage(ctx.root_page_id_));
+  ctx.write_set_.push_back(WriteNode(ctx.root_page_id_));
 
   while (true) {
-    auto cur_page = ctx.write_set_.back().AsMut<BPlusTreePage>();
+    auto cur_page = ctx.write_set_.back().As<BPlusTreePage>();
     if (cur_page->IsLeafPage()) {
       break;
     }
-    auto page = ctx.write_set_.back().AsMut<InternalPage>();
-    auto page_size = page->GetSize();
-    auto slot = page_size - 1;
-    for (int i = 1; i < page_size; ++i) {
-      if (comparator_(page->KeyAt(i), key) >= 0) {
-        slot = i;
-        break;
-      }
-    }
-    if (comparator_(key, page->KeyAt(slot)) < 0) {
-      --slot;
-    }
-    ctx.write_set_.push_back(bpm_->WritePage(page->ValueAt(slot)));
+    auto page = ctx.write_set_.back().As<InternalPage>();
+    auto slot = page->LookUp(key, comparator_);
+    ctx.slot_set_.push_back(slot);
+    ctx.write_set_.push_back(WriteNode(page->ValueAt(slot)));
   }
   // Delete the key in leaf-page
-  auto leaf_page = ctx.write_set_.back().AsMut<LeafPage>();
-  auto leaf_size = leaf_page->GetSize();
-  auto position = -1;
-  for (int i = 0; i < leaf_size; ++i) {
-    if (comparator_(key, leaf_page->KeyAt(i)) == 0) {
-      position = i;
-      break;
-    }
-  }
-  if (position == -1) {
+  auto leaf_view = ctx.write_set_.back().As<LeafPage>();
+  auto leaf_size = leaf_view->GetSize();
+  auto position = leaf_view->KeyIndex(key, comparator_);
+  if (position == leaf_size ||
+      comparator_(key, leaf_view->KeyAt(position)) != 0) {
     return;
   }
-  for (int i = position; i < leaf_size - 1; ++i) {
-    leaf_page->SetKeyAt(i, leaf_page->KeyAt(i + 1));
-    leaf_page->SetRidAt(i, leaf_page->RidAt(i + 1));
-  }
+  AddToPathCounts(ctx, -1);
+  auto leaf_page = ctx.write_set_.back().AsMut<LeafPage>();
+  leaf_page->RemoveAt(position);
   --leaf_size;
-  leaf_page->SetSize(leaf_size);
   // Special case:leaf-page as root ,if it has no key, just delete whole tree
   if (ctx.root_page_id_ == ctx.write_set_.back().GetPageId()) {
     if (leaf_size == 0) {
+      hint_.Clear();
       ctx.write_set_.back().Drop();
-      bpm_->DeletePage(ctx.root_page_id_);
-      ctx.header_page_->AsMut<BPlusTreeHeaderPage>()->root_page_id_ =
-          INVALID_PAGE_ID;
+      ReleasePage(ctx.root_page_id_);
+      SetRootPageId(INVALID_PAGE_ID);
     }
     return;
   }
   // If leaf-page has enough keys,just return
-  if (leaf_size >= leaf_page->GetMinSize()) {
+  if (leaf_page->Load() >= LeafUnderflowLoad(leaf_page)) {
     return;
   }
+  hint_.Clear();
   // Else we have two options: borrow or coalesce
   // First we only execute on the leaf, execution on internal page is similar
   auto leaf_parent_page = ctx.write_set_[ctx.write_set_.size() - 2].AsMut<
@@ -449,124 +1231,97 @@ void BPLUSTREE_TYPE::Remove(const KeyType& key) {
   // Borrow situation
   if (leaf_position > 0) {
     auto left_sib_pos = leaf_position - 1;
-    auto left_sib_guard = bpm_->WritePage(
+    auto left_sib_guard = WriteNode(
         leaf_parent_page->ValueAt(left_sib_pos));
     auto left_sib_page = left_sib_guard.template AsMut<LeafPage>();
-    if (left_sib_page->GetSize() > left_sib_page->GetMinSize()) {
-      auto borrowed_key = left_sib_page->KeyAt(left_sib_page->GetSize() - 1);
-      auto borrowed_value = left_sib_page->RidAt(left_sib_page->GetSize() - 1);
-      left_sib_page->ChangeSizeBy(-1);
-      for (int i = leaf_size - 1; i >= 0; --i) {
-        leaf_page->SetKeyAt(i + 1, leaf_page->KeyAt(i));
-        leaf_page->SetRidAt(i + 1, leaf_page->RidAt(i));
-      }
+    auto last = left_sib_page->GetSize() - 1;
+    auto borrowed_value = left_sib_page->RidAt(last);
+    if (left_sib_page->Load() - LeafPage::EntryCost(borrowed_value) >=
+            left_sib_page->MinLoad() &&
+        leaf_page->CanHold(borrowed_value)) {
+      auto borrowed_key = left_sib_page->KeyAt(last);
+      left_sib_page->RemoveAt(last);
+      leaf_page->InsertAt(0, borrowed_key, borrowed_value);
       ++leaf_size;
-      leaf_page->ChangeSizeBy(1);
-      leaf_page->SetKeyAt(0, borrowed_key);
-      leaf_page->SetRidAt(0, borrowed_value);
 
       leaf_parent_page->SetKeyAt(leaf_position, borrowed_key);
+      leaf_parent_page->SetCountAt(left_sib_pos, left_sib_page->GetSize());
+      leaf_parent_page->SetCountAt(leaf_position, leaf_size);
       return;
     }
   }
   if (leaf_position < leaf_parent_page->GetSize() - 1) {
     auto right_sib_pos = leaf_position + 1;
-    auto right_sib_guard = bpm_->WritePage(
+    auto right_sib_guard = WriteNode(
         leaf_parent_page->ValueAt(right_sib_pos));
     auto right_sib_page = right_sib_guard.template AsMut<LeafPage>();
-    auto right_sib_size = right_sib_page->GetSize();
-    if (right_sib_page->GetSize() > right_sib_page->GetMinSize()) {
+    auto borrowed_value = right_sib_page->RidAt(0);
+    if (right_sib_page->Load() - LeafPage::EntryCost(borrowed_value) >=
+            right_sib_page->MinLoad() &&
+        leaf_page->CanHold(borrowed_value)) {
       auto borrowed_key = right_sib_page->KeyAt(0);
-      auto borrowed_value = right_sib_page->RidAt(0);
-      for (int i = 0; i < right_sib_size - 1; ++i) {
-        right_sib_page->SetKeyAt(i, right_sib_page->KeyAt(i + 1));
-        right_sib_page->SetRidAt(i, right_sib_page->RidAt(i + 1));
-      }
-      --right_sib_size;
-      right_sib_page->SetSize(right_sib_size);
+      right_sib_page->RemoveAt(0);
+      auto right_sib_size = right_sib_page->GetSize();
+      leaf_page->InsertAt(leaf_size, borrowed_key, borrowed_value);
       ++leaf_size;
-      leaf_page->SetSize(leaf_size);
-      leaf_page->SetKeyAt(leaf_size - 1, borrowed_key);
-      leaf_page->SetRidAt(leaf_size - 1, borrowed_value);
       leaf_parent_page->SetKeyAt(right_sib_pos, right_sib_page->KeyAt(0));
+      leaf_parent_page->SetCountAt(right_sib_pos, right_sib_size);
+      leaf_parent_page->SetCountAt(leaf_position, leaf_size);
       return;
     }
   }
   // Coalesce situation
+  // A slotted leaf whose siblings can neither lend nor take its entries is
+  // left underfull.
   auto position_to_delete = leaf_position;
-  sjtu::vector<KeyType> leaf_keys;
-  sjtu::vector<ValueType> leaf_values;
   if (leaf_position > 0) {
     auto left_sib_pos = leaf_position - 1;
-    auto left_sib_guard = bpm_->WritePage(
+    auto left_sib_guard = WriteNode(
         leaf_parent_page->ValueAt(left_sib_pos));
     auto left_sib_page = left_sib_guard.template AsMut<LeafPage>();
-    auto left_sib_size = left_sib_page->GetSize();
-    if (left_sib_size + leaf_size <= left_sib_page->GetMaxSize()) {
-      for (auto i = 0; i < left_sib_size; ++i) {
-        leaf_keys.push_back(left_sib_page->KeyAt(i));
-        leaf_values.push_back(left_sib_page->RidAt(i));
-      }
-      for (auto i = 0; i < leaf_size; ++i) {
-        leaf_keys.push_back(leaf_page->KeyAt(i));
-        leaf_values.push_back(leaf_page->RidAt(i));
-      }
-      left_sib_size += leaf_size;
-      left_sib_page->SetSize(left_sib_size);
-      for (auto i = 0; i < left_sib_size; ++i) {
-        left_sib_page->SetKeyAt(i, leaf_keys[i]);
-        left_sib_page->SetRidAt(i, leaf_values[i]);
-      }
+    if (left_sib_page->Load() + leaf_page->Load() >
+        left_sib_page->Capacity()) {
+      return;
     }
+    leaf_page->MoveTailTo(left_sib_page, 0);
+    leaf_parent_page->SetCountAt(left_sib_pos, left_sib_page->GetSize());
     left_sib_page->SetNextPageId(leaf_page->GetNextPageId());
-    bpm_->DeletePage(leaf_parent_page->ValueAt(leaf_position));
+    RelinkPrevPage(leaf_page->GetNextPageId(), left_sib_guard.GetPageId());
+    ReleasePage(leaf_parent_page->ValueAt(leaf_position));
   } else {
     position_to_delete = leaf_position + 1;
 
     auto right_sib_pos = leaf_position + 1;
-    auto right_sib_guard = bpm_->WritePage(
+    auto right_sib_guard = WriteNode(
         leaf_parent_page->ValueAt(right_sib_pos));
     auto right_sib_page = right_sib_guard.template AsMut<LeafPage>();
     auto right_sib_size = right_sib_page->GetSize();
-    for (auto i = 0; i < leaf_size; ++i) {
-      leaf_keys.push_back(leaf_page->KeyAt(i));
-      leaf_values.push_back(leaf_page->RidAt(i));
-    }
-    for (auto i = 0; i < right_sib_size; ++i) {
-      leaf_keys.push_back(right_sib_page->KeyAt(i));
-      leaf_values.push_back(right_sib_page->RidAt(i));
+    if (leaf_page->Load() + right_sib_page->Load() > leaf_page->Capacity()) {
+      return;
     }
-
+    right_sib_page->MoveTailTo(leaf_page, 0);
     leaf_size += right_sib_size;
-    leaf_page->SetSize(leaf_size);
-    for (auto i = 0; i < leaf_size; ++i) {
-      leaf_page->SetKeyAt(i, leaf_keys[i]);
-      leaf_page->SetRidAt(i, leaf_values[i]);
-    }
+    leaf_parent_page->SetCountAt(leaf_position, leaf_size);
     leaf_page->SetNextPageId(right_sib_page->GetNextPageId());
-    bpm_->DeletePage(leaf_parent_page->ValueAt(right_sib_pos));
+    RelinkPrevPage(right_sib_page->GetNextPageId(),
+                   ctx.write_set_.back().GetPageId());
+    ReleasePage(leaf_parent_page->ValueAt(right_sib_pos));
   }
   ctx.write_set_.pop_back();
 
   while (!ctx.write_set_.empty()) {
     auto cur_page = ctx.write_set_.back().template AsMut<InternalPage>();
-    auto cur_size = cur_page->GetSize();
     // First delete the invalid key
-    for (int i = position_to_delete; i < cur_size - 1; ++i) {
-      cur_page->SetKeyAt(i, cur_page->KeyAt(i + 1));
-      cur_page->SetValueAt(i, cur_page->ValueAt(i + 1));
-    }
-    --cur_size;
-    cur_page->SetSize(cur_size);
+    cur_page->RemoveAt(position_to_delete);
+    auto cur_size = cur_page->GetSize();
     if (ctx.write_set_.back().GetPageId() == ctx.root_page_id_) {
       if (cur_size == 1) {
-        ctx.header_page_->AsMut<BPlusTreeHeaderPage>()->root_page_id_ = cur_page
-            ->ValueAt(0);
-        bpm_->DeletePage(ctx.root_page_id_);
+        SetRootPageId(cur_page->ValueAt(0));
+        ReleasePage(ctx.root_page_id_);
       }
       return;
     }
-    if (cur_size >= cur_page->GetMinSize()) {
+    if (cur_size >= UnderflowSize(cur_page)) {
       return;
     }
     auto cur_parent_page = ctx.write_set_[ctx.write_set_.size() - 2].AsMut<
@@ -577,7 +1332,7 @@ void BPLUSTREE_TYPE::Remove(const KeyType& key) {
     // Note: If we can borrow we can immediately return
     if (cur_position > 0) {
       auto left_sib_pos = cur_position - 1;
-      auto left_sib_guard = bpm_->WritePage(
+      auto left_sib_guard = WriteNode(
           cur_parent_page->ValueAt(left_sib_pos));
       auto left_sib_page = left_sib_guard.template AsMut<InternalPage>();
       if (left_sib_page->GetSize() > left_sib_page->GetMinSize()) {
@@ -587,101 +1342,597 @@ void BPLUSTREE_TYPE::Remove(const KeyType& key) {
         auto borrowed_key = cur_parent_page->KeyAt(cur_position);
         auto borrowed_value = left_sib_page->ValueAt(
             left_sib_page->GetSize() - 1);
+        auto borrowed_count = left_sib_page->CountAt(
+            left_sib_page->GetSize() - 1);
         left_sib_page->ChangeSizeBy(-1);
-        for (int i = cur_size - 1; i >= 0; --i) {
-          cur_page->SetKeyAt(i + 1, cur_page->KeyAt(i));
-          cur_page->SetValueAt(i + 1, cur_page->ValueAt(i));
-        }
-        ++cur_size;
-        cur_page->ChangeSizeBy(1);
+        cur_page->InsertAt(0, borrowed_key, borrowed_value, borrowed_count);
         cur_page->SetKeyAt(1, borrowed_key);
-        cur_page->SetValueAt(0, borrowed_value);
         cur_parent_page->SetKeyAt(cur_position, update_key);
+        cur_parent_page->SetCountAt(
+            left_sib_pos, cur_parent_page->CountAt(left_sib_pos) -
+                              borrowed_count);
+        cur_parent_page->SetCountAt(
+            cur_position, cur_parent_page->CountAt(cur_position) +
+                              borrowed_count);
         return;
       }
     }
     if (cur_position < cur_parent_page->GetSize() - 1) {
       auto right_sib_pos = cur_position + 1;
-      auto right_sib_guard = bpm_->WritePage(
+      auto right_sib_guard = WriteNode(
           cur_parent_page->ValueAt(right_sib_pos));
       auto right_sib_page = right_sib_guard.template AsMut<InternalPage>();
-      auto right_sib_size = right_sib_page->GetSize();
       if (right_sib_page->GetSize() > right_sib_page->GetMinSize()) {
         // Node:We will borrow parent key in this part and replace it by the key we deleted to keep balance
         auto update_key = right_sib_page->KeyAt(1);
 
         auto borrowed_key = cur_parent_page->KeyAt(right_sib_pos);
         auto borrowed_value = right_sib_page->ValueAt(0);
-        for (int i = 0; i < right_sib_size - 1; ++i) {
-          right_sib_page->SetKeyAt(i, right_sib_page->KeyAt(i + 1));
-          right_sib_page->SetValueAt(i, right_sib_page->ValueAt(i + 1));
-        }
-        --right_sib_size;
-        right_sib_page->ChangeSizeBy(-1);
-        ++cur_size;
-        cur_page->ChangeSizeBy(1);
-        cur_page->SetKeyAt(cur_size - 1, borrowed_key);
-        cur_page->SetValueAt(cur_size - 1, borrowed_value);
+        auto borrowed_count = right_sib_page->CountAt(0);
+        right_sib_page->RemoveAt(0);
+        cur_page->InsertAt(cur_size, borrowed_key, borrowed_value,
+                           borrowed_count);
         cur_parent_page->SetKeyAt(right_sib_pos, update_key);
+        cur_parent_page->SetCountAt(
+            right_sib_pos, cur_parent_page->CountAt(right_sib_pos) -
+                               borrowed_count);
+        cur_parent_page->SetCountAt(
+            cur_position, cur_parent_page->CountAt(cur_position) +
+                              borrowed_count);
         return;
       }
     }
 
-    sjtu::vector<KeyType> internal_keys;
-    sjtu::vector<page_id_t> internal_values;
+    // The separator in the parent comes down as the key of the first child of
+    // the right page, whose entries are then appended to the left one.
     if (cur_position > 0) {
       position_to_delete = cur_position;
       auto left_sib_pos = cur_position - 1;
-      auto left_sib_guard = bpm_->WritePage(
+      auto left_sib_guard = WriteNode(
           cur_parent_page->ValueAt(left_sib_pos));
       auto left_sib_page = left_sib_guard.template AsMut<InternalPage>();
       auto left_sib_size = left_sib_page->GetSize();
       if (left_sib_size + cur_size <= left_sib_page->GetMaxSize()) {
-        for (int i = 0; i < left_sib_size; ++i) {
-          internal_keys.push_back(left_sib_page->KeyAt(i));
-          internal_values.push_back(left_sib_page->ValueAt(i));
-        }
-        internal_keys.push_back(cur_parent_page->KeyAt(cur_position));
-        internal_values.push_back(cur_page->ValueAt(0));
-        for (int i = 1; i < cur_size; ++i) {
-          internal_keys.push_back(cur_page->KeyAt(i));
-          internal_values.push_back(cur_page->ValueAt(i));
-        }
-        left_sib_size += cur_size;
-        left_sib_page->SetSize(left_sib_size);
-        for (int i = 0; i < left_sib_size; ++i) {
-          left_sib_page->SetKeyAt(i, internal_keys[i]);
-          left_sib_page->SetValueAt(i, internal_values[i]);
-        }
-        bpm_->DeletePage(cur_parent_page->ValueAt(cur_position));
+        cur_page->SetKeyAt(0, cur_parent_page->KeyAt(cur_position));
+        cur_page->MoveTailTo(left_sib_page, 0);
+        cur_parent_page->SetCountAt(left_sib_pos, left_sib_page->CountSum());
+        ReleasePage(cur_parent_page->ValueAt(cur_position));
       }
     } else {
       position_to_delete = cur_position + 1;
       auto right_sib_pos = cur_position + 1;
-      auto right_sib_guard = bpm_->WritePage(
+      auto right_sib_guard = WriteNode(
           cur_parent_page->ValueAt(right_sib_pos));
       auto right_sib_page = right_sib_guard.template AsMut<InternalPage>();
-      auto right_sib_size = right_sib_page->GetSize();
-      for (int i = 0; i < cur_size; ++i) {
-        internal_keys.push_back(cur_page->KeyAt(i));
-        internal_values.push_back(cur_page->ValueAt(i));
+      right_sib_page->SetKeyAt(0, cur_parent_page->KeyAt(right_sib_pos));
+      right_sib_page->MoveTailTo(cur_page, 0);
+      cur_parent_page->SetCountAt(cur_position, cur_page->CountSum());
+      ReleasePage(cur_parent_page->ValueAt(right_sib_pos));
+    }
+    ctx.write_set_.pop_back();
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::RemoveRange(const KeyType& lo, const KeyType& hi) -> int {
+  return RemoveRangeImpl(lo, hi, comparator_);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::RemovePrefix(const KeyType& prefix) -> int {
+  return RemoveRangeImpl(prefix, prefix, degraded_comparator_);
+}
+
+/**
+ * @brief Remove the entries within [lo, hi] under comparator in two passes
+ *
+ * The first pass descends along both ends of the range, trims the two leaves
+ * it ends in and releases every subtree in between, then the leaf chain is
+ * closed over the gap. The second pass walks the same two paths again, drops
+ * the pages left empty and merges the underfull ones with a neighbor, and is
+ * repeated (at most once per level) until the pages it merged are valid.
+ * Pages that do not fit together are left underfull, as Remove does.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+template <typename Comparator>
+auto BPLUSTREE_TYPE::RemoveRangeImpl(const KeyType& lo, const KeyType& hi,
+                                     const Comparator& comparator) -> int {
+  auto root_id = GetRootPageId();
+  if (root_id == INVALID_PAGE_ID || comparator(lo, hi) > 0) {
+    return 0;
+  }
+  RangeRemoval removal;
+  int removed = RemoveRangeSubtree(root_id, 0, lo, hi, comparator, &removal);
+  if (removed == 0) {
+    return 0;
+  }
+  hint_.Clear();
+  if (bloom_.IsEnabled()) {
+    bloom_.NoteRemove(removed);
+  }
+
+  page_id_t left_end;
+  page_id_t right_end;
+  {
+    auto guard = bpm_->ReadPage(removal.first_leaf_);
+    auto leaf_page = guard.template As<LeafPage>();
+    left_end = leaf_page->GetSize() > 0 ? removal.first_leaf_ : leaf_page->GetPrevPageId();
+  }
+  {
+    auto guard = bpm_->ReadPage(removal.last_leaf_);
+    auto leaf_page = guard.template As<LeafPage>();
+    right_end = leaf_page->GetSize() > 0 ? removal.last_leaf_ : leaf_page->GetNextPageId();
+  }
+  if (left_end != removal.first_leaf_ || right_end != removal.last_leaf_ ||
+      removal.first_leaf_ != removal.last_leaf_) {
+    if (left_end != INVALID_PAGE_ID) {
+      WriteNode(left_end).template AsMut<LeafPage>()->SetNextPageId(right_end);
+    }
+    RelinkPrevPage(right_end, left_end);
+  }
+
+  bool changed = true;
+  while (changed) {
+    root_id = GetRootPageId();
+    bool is_leaf;
+    int size;
+    page_id_t only_child = INVALID_PAGE_ID;
+    {
+      auto guard = bpm_->ReadPage(root_id);
+      auto page = guard.template As<BPlusTreePage>();
+      is_leaf = page->IsLeafPage();
+      size = page->GetSize();
+      if (!is_leaf && size == 1) {
+        only_child = guard.template As<InternalPage>()->ValueAt(0);
+      }
+    }
+    if (size == 0) {
+      ReleasePage(root_id);
+      SetRootPageId(INVALID_PAGE_ID);
+      break;
+    }
+    if (is_leaf) {
+      break;
+    }
+    if (size == 1) {
+      SetRootPageId(only_child);
+      ReleasePage(root_id);
+      continue;
+    }
+    changed = FixRangeBoundary(root_id, lo, hi, comparator);
+  }
+  return removed;
+}
+
+/**
+ * @return number of entries removed from the subtree of page_id
+ */
+INDEX_TEMPLATE_ARGUMENTS
+template <typename Comparator>
+auto BPLUSTREE_TYPE::RemoveRangeSubtree(page_id_t page_id, int depth,
+                                        const KeyType& lo, const KeyType& hi,
+                                        const Comparator& comparator,
+                                        RangeRemoval* removal) -> int {
+  auto guard = WriteNode(page_id);
+  if (guard.template As<BPlusTreePage>()->IsLeafPage()) {
+    auto leaf_page = guard.template AsMut<LeafPage>();
+    auto begin = leaf_page->KeyIndex(lo, comparator);
+    auto end = leaf_page->KeyUpperIndex(hi, comparator);
+    for (int i = end - 1; i >= begin; --i) {
+      leaf_page->RemoveAt(i);
+    }
+    if (removal->first_leaf_ == INVALID_PAGE_ID) {
+      removal->first_leaf_ = page_id;
+      removal->leaf_depth_ = depth;
+    }
+    removal->last_leaf_ = page_id;
+    return end > begin ? end - begin : 0;
+  }
+  auto page = guard.template AsMut<InternalPage>();
+  auto first = page->LookUpBefore(lo, comparator);
+  auto last = page->LookUp(hi, comparator);
+  int removed = RemoveRangeSubtree(page->ValueAt(first), depth + 1, lo, hi,
+                                   comparator, removal);
+  page->SetCountAt(first, page->CountAt(first) - removed);
+  if (last > first) {
+    int last_removed = RemoveRangeSubtree(page->ValueAt(last), depth + 1, lo,
+                                          hi, comparator, removal);
+    page->SetCountAt(last, page->CountAt(last) - last_removed);
+    removed += last_removed;
+    // the children in between lie entirely within the range
+    for (int i = last - 1; i > first; --i) {
+      removed += ReleaseSubtree(page->ValueAt(i), removal->leaf_depth_ - depth - 1,
+                                page->CountAt(i));
+      page->RemoveAt(i);
+    }
+  }
+  return removed;
+}
+
+/**
+ * @brief Release every page of a subtree
+ *
+ * Counted trees take the entry counts from the parents, so their leaves are
+ * released without being read.
+ *
+ * @return number of entries the subtree held
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::ReleaseSubtree(page_id_t page_id, int levels, int count)
+  -> int {
+  if (levels == 0) {
+    if (!counted_) {
+      count = bpm_->ReadPage(page_id).template As<LeafPage>()->GetSize();
+    }
+    ReleasePage(page_id);
+    return count;
+  }
+  auto guard = bpm_->ReadPage(page_id);
+  auto page = guard.template As<InternalPage>();
+  int entry_cnt = 0;
+  for (int i = 0; i < page->GetSize(); ++i) {
+    entry_cnt += ReleaseSubtree(page->ValueAt(i), levels - 1, page->CountAt(i));
+  }
+  guard.Drop();
+  ReleasePage(page_id);
+  return entry_cnt;
+}
+
+/**
+ * @brief Clean up the children of an internal page along both ends of a
+ * removed range, bottom-up
+ *
+ * @return true if any page was dropped, merged or lent an entry
+ */
+INDEX_TEMPLATE_ARGUMENTS
+template <typename Comparator>
+auto BPLUSTREE_TYPE::FixRangeBoundary(page_id_t page_id, const KeyType& lo,
+                                      const KeyType& hi,
+                                      const Comparator& comparator) -> bool {
+  auto guard = WriteNode(page_id);
+  auto page = guard.template AsMut<InternalPage>();
+  bool changed = false;
+  auto first = page->LookUpBefore(lo, comparator);
+  auto last = page->LookUp(hi, comparator);
+  for (int i = last; i >= first; --i) {
+    auto child_id = page->ValueAt(i);
+    if (!bpm_->ReadPage(child_id).template As<BPlusTreePage>()->IsLeafPage()) {
+      changed |= FixRangeBoundary(child_id, lo, hi, comparator);
+    }
+    if (bpm_->ReadPage(child_id).template As<BPlusTreePage>()->GetSize() == 0) {
+      ReleasePage(child_id);
+      page->RemoveAt(i);
+      changed = true;
+    }
+  }
+  if (page->GetSize() == 0) {
+    return changed;
+  }
+  first = page->LookUpBefore(lo, comparator);
+  last = page->LookUp(hi, comparator);
+  for (int i = last; i >= first; --i) {
+    if (i + 1 < page->GetSize()) {
+      changed |= RebalanceChildren(page, i);
+    } else if (i > 0) {
+      changed |= RebalanceChildren(page, i - 1);
+    }
+  }
+  return changed;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::RebalanceChildren(InternalPage* parent, int left_pos)
+  -> bool {
+  auto left_id = parent->ValueAt(left_pos);
+  auto right_id = parent->ValueAt(left_pos + 1);
+  {
+    auto left_guard = bpm_->ReadPage(left_id);
+    auto right_guard = bpm_->ReadPage(right_id);
+    if (left_guard.template As<BPlusTreePage>()->IsLeafPage()) {
+      auto left = left_guard.template As<LeafPage>();
+      auto right = right_guard.template As<LeafPage>();
+      if ((left->Load() >= LeafUnderflowLoad(left) &&
+           right->Load() >= LeafUnderflowLoad(right)) ||
+          left->Load() + right->Load() > left->Capacity()) {
+        return false;
       }
-      internal_keys.push_back(cur_parent_page->KeyAt(right_sib_pos));
-      internal_values.push_back(right_sib_page->ValueAt(0));
-      for (int i = 1; i < right_sib_size; ++i) {
-        internal_keys.push_back(right_sib_page->KeyAt(i));
-        internal_values.push_back(right_sib_page->ValueAt(i));
+    } else {
+      auto left = left_guard.template As<InternalPage>();
+      auto right = right_guard.template As<InternalPage>();
+      auto left_size = left->GetSize();
+      auto right_size = right->GetSize();
+      if (left_size >= std::max(UnderflowSize(left), 2) &&
+          right_size >= std::max(UnderflowSize(right), 2)) {
+        return false;
       }
-      cur_size += right_sib_size;
-      cur_page->SetSize(cur_size);
-      for (int i = 0; i < cur_size; ++i) {
-        cur_page->SetKeyAt(i, internal_keys[i]);
-        cur_page->SetValueAt(i, internal_values[i]);
+      if (left_size + right_size > left->GetMaxSize() && left_size >= 2 &&
+          right_size >= 2) {
+        return false;
       }
-      bpm_->DeletePage(cur_parent_page->ValueAt(right_sib_pos));
     }
-    ctx.write_set_.pop_back();
   }
+
+  auto left_guard = WriteNode(left_id);
+  auto right_guard = WriteNode(right_id);
+  if (left_guard.template As<BPlusTreePage>()->IsLeafPage()) {
+    auto left = left_guard.template AsMut<LeafPage>();
+    auto right = right_guard.template AsMut<LeafPage>();
+    right->MoveTailTo(left, 0);
+    left->SetNextPageId(right->GetNextPageId());
+    RelinkPrevPage(right->GetNextPageId(), left_id);
+    parent->SetCountAt(left_pos, left->GetSize());
+  } else {
+    auto left = left_guard.template AsMut<InternalPage>();
+    auto right = right_guard.template AsMut<InternalPage>();
+    auto left_size = left->GetSize();
+    auto right_size = right->GetSize();
+    auto separator = parent->KeyAt(left_pos + 1);
+    if (left_size + right_size > left->GetMaxSize()) {
+      // too large to merge, so one of them is left with a single child and
+      // takes one from the other
+      if (left_size < 2) {
+        left->InsertAt(left_size, separator, right->ValueAt(0), right->CountAt(0));
+        parent->SetKeyAt(left_pos + 1, right->KeyAt(1));
+        right->RemoveAt(0);
+      } else {
+        auto last = left_size - 1;
+        right->InsertAt(0, separator, left->ValueAt(last), left->CountAt(last));
+        right->SetKeyAt(1, separator);
+        parent->SetKeyAt(left_pos + 1, left->KeyAt(last));
+        left->RemoveAt(last);
+      }
+      parent->SetCountAt(left_pos, left->CountSum());
+      parent->SetCountAt(left_pos + 1, right->CountSum());
+      return true;
+    }
+    right->SetKeyAt(0, separator);
+    right->MoveTailTo(left, 0);
+    parent->SetCountAt(left_pos, left->CountSum());
+  }
+  left_guard.Drop();
+  right_guard.Drop();
+  ReleasePage(right_id);
+  parent->RemoveAt(left_pos + 1);
+  return true;
+}
+
+/**
+ * @brief Find the leaf page that may contain key
+ *
+ * @return read guard of the leaf page, nullopt if the tree is empty
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::FindLeafPage(const KeyType& key)
+  -> std::optional<ReadPageGuard> {
+  auto root_id = GetRootPageId();
+  if (root_id == INVALID_PAGE_ID) {
+    return std::nullopt;
+  }
+  ReadPageGuard cur_guard;
+  auto cur_page = ReadNode(root_id, 0, &cur_guard);
+  for (int depth = 1; !cur_page->IsLeafPage(); ++depth) {
+    auto page = static_cast<const InternalPage*>(cur_page);
+    cur_page = ReadNode(page->ValueAt(page->LookUp(key, comparator_)), depth,
+                        &cur_guard);
+  }
+  return cur_guard;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::MayContain(const KeyType& key) const -> bool {
+  return !bloom_.IsEnabled() || bloom_.MayContain(KeyHash(key));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::AddToBloomFilter(const KeyType& key) {
+  if (!bloom_.IsEnabled()) {
+    return;
+  }
+  bloom_.Add(KeyHash(key));
+  if (bloom_.NeedsRebuild()) {
+    RebuildBloomFilter();
+  }
+}
+
+/**
+ * @brief Refill the Bloom filter from the keys in the leaves, sized for
+ * twice as many keys so that it takes a while to get crowded again
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::RebuildBloomFilter() {
+  sjtu::vector<uint64_t> hashes;
+  auto root_id = GetRootPageId();
+  if (root_id != INVALID_PAGE_ID) {
+    ReadPageGuard cur_guard;
+    auto cur_page = ReadNode(root_id, 0, &cur_guard);
+    for (int depth = 1; !cur_page->IsLeafPage(); ++depth) {
+      cur_page = ReadNode(static_cast<const InternalPage*>(cur_page)->ValueAt(0),
+                          depth, &cur_guard);
+    }
+    while (true) {
+      auto leaf_page = cur_guard.template As<LeafPage>();
+      for (int i = 0; i < leaf_page->GetSize(); ++i) {
+        hashes.push_back(KeyHash(leaf_page->KeyAt(i)));
+      }
+      auto next_page_id = leaf_page->GetNextPageId();
+      if (next_page_id == INVALID_PAGE_ID) {
+        break;
+      }
+      cur_guard = bpm_->ReadPage(next_page_id);
+    }
+  }
+  int key_cnt = hashes.size();
+  bloom_.Reset(std::max(key_cnt * 2, BLOOM_MIN_CAPACITY), bloom_bits_per_key_);
+  for (int i = 0; i < key_cnt; ++i) {
+    bloom_.Add(hashes[i]);
+  }
+}
+
+/**
+ * @brief Find the leaf holding the last entry that is not greater than prefix
+ * under the degraded comparator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::FindLastLeafPage(const KeyType& prefix)
+  -> std::optional<ReadPageGuard> {
+  auto root_id = GetRootPageId();
+  if (root_id == INVALID_PAGE_ID) {
+    return std::nullopt;
+  }
+  ReadPageGuard cur_guard;
+  auto cur_page = ReadNode(root_id, 0, &cur_guard);
+  for (int depth = 1; !cur_page->IsLeafPage(); ++depth) {
+    auto page = static_cast<const InternalPage*>(cur_page);
+    cur_page = ReadNode(page->ValueAt(page->LookUp(prefix, degraded_comparator_)),
+                        depth, &cur_guard);
+  }
+  return cur_guard;
+}
+
+/*****************************************************************************
+ * INSPECTION
+ *****************************************************************************/
+void BPlusTreeStats::Print(std::ostream &os, const std::string &name) const {
+  os << name << ": height " << height_ << ", entries " << entry_cnt_ << ", pages";
+  for (size_t i = 0; i < level_pages_.size(); ++i) {
+    os << (i == 0 ? " " : "/") << level_pages_[i];
+  }
+  os << ", fill";
+  for (size_t i = 0; i < level_fill_.size(); ++i) {
+    os << (i == 0 ? " " : "/") << static_cast<int>(level_fill_[i] * 100 + 0.5) << '%';
+  }
+  os << ", leaf chain " << leaf_chain_length_ << ", file pages " << page_cnt_
+     << ", orphans " << orphan_page_cnt_ << ", order violations " << order_violation_cnt_
+     << ", structure violations " << structure_violation_cnt_ << '\n';
+}
+
+/**
+ * @brief Visit every page reachable from the root and the leaf chain
+ *
+ * Read-only, but it touches every page of the index through the buffer pool,
+ * so it is meant for maintenance rather than the request path.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::Stats() -> BPlusTreeStats {
+  BPlusTreeStats stats;
+  stats.page_cnt_ = bpm_->GetNextPageId();
+  int reserved_cnt = 1 + bpm_->ReadPage(header_page_id_).template As<BPlusTreeHeaderPage>()->
+                             bloom_.page_cnt_;
+  if (root_page_id_ == INVALID_PAGE_ID) {
+    stats.orphan_page_cnt_ = std::max(0, stats.page_cnt_ - reserved_cnt);
+    return stats;
+  }
+
+  sjtu::vector<page_id_t> leaves;
+  stats.entry_cnt_ = InspectSubtree(root_page_id_, 0, std::nullopt, std::nullopt,
+                                    &leaves, &stats);
+  int reached_cnt = 0;
+  for (size_t i = 0; i < stats.level_pages_.size(); ++i) {
+    reached_cnt += stats.level_pages_[i];
+    stats.level_fill_[i] /= stats.level_pages_[i];
+  }
+  stats.orphan_page_cnt_ = std::max(0, stats.page_cnt_ - reserved_cnt - reached_cnt);
+
+  // The leaf chain must visit exactly the leaves of the tree, left to right.
+  // Stop after one step too many in case the chain loops.
+  page_id_t prev_page_id = INVALID_PAGE_ID;
+  page_id_t cur_page_id = leaves.empty() ? INVALID_PAGE_ID : leaves[0];
+  while (cur_page_id != INVALID_PAGE_ID &&
+         stats.leaf_chain_length_ <= static_cast<int>(leaves.size())) {
+    ReadPageGuard guard = bpm_->ReadPage(cur_page_id);
+    auto leaf_page = guard.template As<LeafPage>();
+    if (stats.leaf_chain_length_ >= static_cast<int>(leaves.size()) ||
+        leaves[stats.leaf_chain_length_] != cur_page_id ||
+        leaf_page->GetPrevPageId() != prev_page_id) {
+      ++stats.structure_violation_cnt_;
+    }
+    ++stats.leaf_chain_length_;
+    prev_page_id = cur_page_id;
+    cur_page_id = leaf_page->GetNextPageId();
+  }
+  if (stats.leaf_chain_length_ != static_cast<int>(leaves.size())) {
+    ++stats.structure_violation_cnt_;
+  }
+  return stats;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::Verify() -> bool {
+  return Stats().IsHealthy();
+}
+
+/**
+ * @brief Check the subtree at page_id, whose keys must lie in [lower, upper)
+ *
+ * Leaves are appended to leaves in key order, and the fill of each page is
+ * summed into its level of stats.
+ *
+ * @return number of entries in the subtree
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::InspectSubtree(page_id_t page_id, int depth,
+                                    const std::optional<KeyType> &lower,
+                                    const std::optional<KeyType> &upper,
+                                    sjtu::vector<page_id_t> *leaves,
+                                    BPlusTreeStats *stats) -> int {
+  ReadPageGuard guard = bpm_->ReadPage(page_id);
+  auto page = guard.template As<BPlusTreePage>();
+  if (static_cast<int>(stats->level_pages_.size()) == depth) {
+    stats->level_pages_.push_back(0);
+    stats->level_fill_.push_back(0);
+  }
+  ++stats->level_pages_[depth];
+  int size = page->GetSize();
+  auto in_range = [&](const KeyType &key) {
+    return (!lower.has_value() || comparator_(key, *lower) >= 0) &&
+           (!upper.has_value() || comparator_(key, *upper) < 0);
+  };
+
+  if (page->IsLeafPage()) {
+    auto leaf_page = guard.template As<LeafPage>();
+    stats->level_fill_[depth] += static_cast<double>(leaf_page->Load()) / leaf_page->Capacity();
+    if (stats->height_ == 0) {
+      stats->height_ = depth + 1;
+    } else if (stats->height_ != depth + 1) {
+      ++stats->structure_violation_cnt_;
+    }
+    // slotted leaves count bytes rather than entries against their capacity
+    if (size == 0 || leaf_page->Load() > leaf_page->Capacity()) {
+      ++stats->structure_violation_cnt_;
+    }
+    for (int i = 0; i < size; ++i) {
+      if (!in_range(leaf_page->KeyAt(i)) ||
+          (i > 0 && comparator_(leaf_page->KeyAt(i - 1), leaf_page->KeyAt(i)) >= 0)) {
+        ++stats->order_violation_cnt_;
+      }
+    }
+    leaves->push_back(page_id);
+    return size;
+  }
+
+  auto internal_page = guard.template As<InternalPage>();
+  stats->level_fill_[depth] += static_cast<double>(size) / internal_page->GetMaxSize();
+  if (size < 2 || size > internal_page->GetMaxSize()) {
+    ++stats->structure_violation_cnt_;
+  }
+  for (int i = 1; i < size; ++i) {
+    if (!in_range(internal_page->KeyAt(i)) ||
+        (i > 1 && comparator_(internal_page->KeyAt(i - 1), internal_page->KeyAt(i)) >= 0)) {
+      ++stats->order_violation_cnt_;
+    }
+  }
+  int entry_cnt = 0;
+  for (int i = 0; i < size; ++i) {
+    std::optional<KeyType> child_lower = i == 0 ? lower : internal_page->KeyAt(i);
+    std::optional<KeyType> child_upper = i + 1 < size ? internal_page->KeyAt(i + 1) : upper;
+    int child_cnt = InspectSubtree(internal_page->ValueAt(i), depth + 1, child_lower,
+                                   child_upper, leaves, stats);
+    if (counted_ && child_cnt != internal_page->CountAt(i)) {
+      ++stats->structure_violation_cnt_;
+    }
+    entry_cnt += child_cnt;
+  }
+  return entry_cnt;
 }
 
 /**
@@ -689,8 +1940,145 @@ void BPLUSTREE_TYPE::Remove(const KeyType& key) {
  */
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::GetRootPageId() -> page_id_t {
-  return bpm_->ReadPage(header_page_id_).As<BPlusTreeHeaderPage>()->
-      root_page_id_;
+  return root_page_id_;
+}
+
+/**
+ * @brief Change the root, in the header page and in the cached copy
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::SetRootPageId(page_id_t root_page_id) {
+  bpm_->WritePage(header_page_id_).AsMut<BPlusTreeHeaderPage>()->root_page_id_ =
+      root_page_id;
+  root_page_id_ = root_page_id;
+}
+
+/**
+ * @brief Read the page at depth of a descent
+ *
+ * Internal pages of the upper PINNED_LEVEL_CNT levels stay pinned once read,
+ * in the slot of pinned_ their page id maps to, and are read from there
+ * without going through the page table and the replacer. Any other page is
+ * read into guard, which must outlive the returned pointer.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::ReadNode(page_id_t page_id, int depth,
+                              ReadPageGuard* guard) -> const BPlusTreePage* {
+  if (depth >= PINNED_LEVEL_CNT || pinned_.empty()) {
+    *guard = bpm_->ReadPage(page_id);
+    return guard->As<BPlusTreePage>();
+  }
+  auto& pinned = pinned_[page_id % pinned_.size()];
+  if (pinned.has_value() && pinned->GetPageId() == page_id) {
+    return pinned->As<BPlusTreePage>();
+  }
+  *guard = bpm_->ReadPage(page_id);
+  auto page = guard->As<BPlusTreePage>();
+  if (!pinned.has_value() && !page->IsLeafPage()) {
+    pinned = bpm_->ReadPage(page_id);
+  }
+  return page;
+}
+
+/**
+ * @brief Unpin a page the tree no longer uses and delete it from the pool
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::ReleasePage(page_id_t page_id) {
+  if (!pinned_.empty()) {
+    auto& pinned = pinned_[page_id % pinned_.size()];
+    if (pinned.has_value() && pinned->GetPageId() == page_id) {
+      pinned = std::nullopt;
+    }
+  }
+  PreservePage(page_id);
+  bpm_->DeletePage(page_id);
+}
+
+/*****************************************************************************
+ * SNAPSHOTS
+ *****************************************************************************/
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::OpenSnapshot() -> int {
+  auto snapshot = new Snapshot;
+  snapshot->id_ = next_snapshot_id_++;
+  snapshot->root_page_id_ = root_page_id_;
+  snapshot->page_limit_ = bpm_->GetNextPageId();
+  snapshots_.push_back(snapshot);
+  return snapshot->id_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::ReleaseSnapshot(int snapshot_id) {
+  for (int i = 0; i < snapshots_.size(); ++i) {
+    if (snapshots_[i]->id_ != snapshot_id) {
+      continue;
+    }
+    auto& copies = snapshots_[i]->copies_;
+    for (auto it = copies.begin(); it != copies.end(); ++it) {
+      auto& refs = copy_refs_[it->second];
+      if (--refs == 0) {
+        page_id_t copy_page_id = it->second;
+        copy_refs_.erase(copy_page_id);
+        bpm_->DeletePage(copy_page_id);
+      }
+    }
+    delete snapshots_[i];
+    snapshots_.erase(i);
+    return;
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::FindSnapshot(int snapshot_id) const -> Snapshot* {
+  for (int i = 0; i < snapshots_.size(); ++i) {
+    if (snapshots_[i]->id_ == snapshot_id) {
+      return snapshots_[i];
+    }
+  }
+  return nullptr;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::ReadSnapshotPage(const Snapshot& snapshot,
+                                      page_id_t page_id) -> ReadPageGuard {
+  auto it = snapshot.copies_.find(page_id);
+  return bpm_->ReadPage(it == snapshot.copies_.cend() ? page_id : it->second);
+}
+
+/**
+ * @brief Copy the page before it changes for the first time since a snapshot
+ * opened
+ *
+ * All snapshots missing the page share one copy. Copies are allocated past
+ * every page_limit_, so they are never preserved themselves.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::PreservePage(page_id_t page_id) {
+  page_id_t copy_page_id = INVALID_PAGE_ID;
+  for (int i = 0; i < snapshots_.size(); ++i) {
+    auto snapshot = snapshots_[i];
+    if (page_id > snapshot->page_limit_ ||
+        snapshot->copies_.find(page_id) != snapshot->copies_.end()) {
+      continue;
+    }
+    if (copy_page_id == INVALID_PAGE_ID) {
+      copy_page_id = bpm_->NewPage();
+      auto copy_guard = bpm_->WritePage(copy_page_id);
+      std::memcpy(copy_guard.GetDataMut(), bpm_->ReadPage(page_id).GetData(),
+                  SJTU_PAGE_SIZE);
+    }
+    snapshot->copies_[page_id] = copy_page_id;
+    ++copy_refs_[copy_page_id];
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::WriteNode(page_id_t page_id) -> WritePageGuard {
+  if (!snapshots_.empty()) {
+    PreservePage(page_id);
+  }
+  return bpm_->WritePage(page_id);
 }
 
 template class BPlusTree<hash_t, UserInfo, HashComp, HashComp>;
@@ -698,6 +2086,8 @@ template class BPlusTree<hash_t, TrainMeta, HashComp, HashComp>;
 
 template class BPlusTree<TrainDate, TicketDateInfo, PairCompare<TrainDate>,
                          PairDegradedCompare<TrainDate> >;
+template class BPlusTree<TrainDate, RID, PairCompare<TrainDate>,
+                         PairDegradedCompare<TrainDate> >;
 template class BPlusTree<OrderTime, OrderInfo, PairCompare<OrderTime>,
                          PairDegradedCompare<OrderTime> >;
 template class BPlusTree<TrainDateOrder, PendingInfo, TDOCompare,
@@ -1,3 +1,4 @@
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include "storage/b_plus_tree_internal_page.h"
@@ -17,13 +18,20 @@ namespace sjtu {
  * including set page type, set current size, set page id, set parent id and set max page size,
  * must be called after the creation of a new page to make a valid BPlusTreeInternalPage.
  *
- * @param max_size Maximal size of the page
+ * @param max_size Maximal size of the page, at most COUNTED_SLOT_CNT if counted
+ * @param counted whether the page keeps subtree entry counts
  */
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(int max_size) {
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(int max_size, bool counted) {
   SetSize(0);
   SetMaxSize(max_size);
   SetPageType(IndexPageType::INTERNAL_PAGE);
+  counted_ = counted ? 1 : 0;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::IsCounted() const -> bool {
+  return counted_ != 0;
 }
 
 /**
@@ -35,7 +43,7 @@ auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueIndex(
     const ValueType& value) const -> int {
   auto size = GetSize();
   for (int i = 0; i < size; ++i) {
-    if (value == page_id_array_[i]) {
+    if (value == PageIdArray()[i]) {
       return i;
     }
   }
@@ -50,8 +58,8 @@ auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueIndex(
  * @return Key at index
  */
 INDEX_TEMPLATE_ARGUMENTS
-auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::KeyAt(int index) const -> KeyType {
-  return key_array_[index];
+auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::KeyAt(int index) const -> const KeyType & {
+  return KeyArray()[index];
 }
 
 /**
@@ -62,7 +70,7 @@ auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::KeyAt(int index) const -> KeyType {
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetKeyAt(int index, const KeyType& key) {
-  key_array_[index] = key;
+  KeyArray()[index] = key;
 }
 
 /**
@@ -74,18 +82,96 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetKeyAt(int index, const KeyType& key) {
  */
 INDEX_TEMPLATE_ARGUMENTS
 auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueAt(int index) const -> ValueType {
-  return page_id_array_[index];
+  return PageIdArray()[index];
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetValueAt(
-    int index, const ValueType& value) { page_id_array_[index] = value; }
+    int index, const ValueType& value) { PageIdArray()[index] = value; }
+
+/**
+ * @brief Helper methods to get/set the entry count of the subtree under child
+ * "index", only meaningful on counted pages
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::CountAt(int index) const -> int {
+  return counted_ != 0 ? CountArray()[index] : 0;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetCountAt(int index, int count) {
+  if (counted_ != 0) {
+    CountArray()[index] = count;
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::CountSum() const -> int {
+  int sum = 0;
+  for (int i = 0; i < GetSize(); ++i) {
+    sum += CountAt(i);
+  }
+  return sum;
+}
+
+/**
+ * @brief Block moves of the key, page id and count columns
+ *
+ * Each column is shifted with one memmove, entries are never copied one by
+ * one.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertAt(int index, const KeyType& key,
+                                              const ValueType& value, int count) {
+  int size = GetSize();
+  int tail = size - index;
+  memmove(KeyArray() + index + 1, KeyArray() + index, tail * sizeof(KeyType));
+  memmove(PageIdArray() + index + 1, PageIdArray() + index, tail * sizeof(ValueType));
+  KeyArray()[index] = key;
+  PageIdArray()[index] = value;
+  if (counted_ != 0) {
+    memmove(CountArray() + index + 1, CountArray() + index, tail * sizeof(int));
+    CountArray()[index] = count;
+  }
+  SetSize(size + 1);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::RemoveAt(int index) {
+  int size = GetSize();
+  int tail = size - index - 1;
+  memmove(KeyArray() + index, KeyArray() + index + 1, tail * sizeof(KeyType));
+  memmove(PageIdArray() + index, PageIdArray() + index + 1, tail * sizeof(ValueType));
+  if (counted_ != 0) {
+    memmove(CountArray() + index, CountArray() + index + 1, tail * sizeof(int));
+  }
+  SetSize(size - 1);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveTailTo(BPlusTreeInternalPage* recipient,
+                                                int begin) {
+  int size = GetSize();
+  int recipient_size = recipient->GetSize();
+  int n = size - begin;
+  memcpy(recipient->KeyArray() + recipient_size, KeyArray() + begin, n * sizeof(KeyType));
+  memcpy(recipient->PageIdArray() + recipient_size, PageIdArray() + begin,
+         n * sizeof(ValueType));
+  if (counted_ != 0) {
+    memcpy(recipient->CountArray() + recipient_size, CountArray() + begin, n * sizeof(int));
+  }
+  recipient->SetSize(recipient_size + n);
+  SetSize(begin);
+}
 
 // valuetype for internalNode should be page id_t
 template class BPlusTreeInternalPage<hash_t, page_id_t, HashComp, HashComp>;
 template class BPlusTreeInternalPage<
   TrainDate, page_id_t, PairCompare<TrainDate>, PairDegradedCompare<
     TrainDate> >;
+template class BPlusTreeInternalPage<
+  OrderTime, page_id_t, PairCompare<OrderTime>, PairDegradedCompare<
+    OrderTime> >;
 template class BPlusTreeInternalPage<
   TrainDateOrder, page_id_t,TDOCompare, TDODegradedCompare >;
 template class BPlusTreeInternalPage<
@@ -1,8 +1,10 @@
+#include <cstring>
 #include <sstream>
 
 
 #include "storage/b_plus_tree_leaf_page.h"
 
+#include "management/ticket.h"
 #include "management/train.h"
 #include "management/user.h"
 
@@ -16,7 +18,7 @@ namespace sjtu {
  *
  * After creating a new leaf page from buffer pool, must call initialize method to set default values,
  * including set page type, set current size to zero, set page id/parent id, set
- * next page id and set max size.
+ * next/prev page id and set max size.
  *
  * @param max_size Max size of the leaf node
  */
@@ -26,10 +28,13 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(int max_size) {
   SetSize(0);
   SetMaxSize(max_size);
   SetNextPageId(INVALID_PAGE_ID);
+  SetPrevPageId(INVALID_PAGE_ID);
+  heap_top_ = LEAF_PAGE_DATA_SIZE;
+  heap_used_ = 0;
 }
 
 /**
- * Helper methods to set/get next page id
+ * Helper methods to set/get next / prev page id
  */
 INDEX_TEMPLATE_ARGUMENTS
 auto B_PLUS_TREE_LEAF_PAGE_TYPE::GetNextPageId() const -> page_id_t {
@@ -41,34 +46,270 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::SetNextPageId(page_id_t next_page_id) {
   next_page_id_ = next_page_id;
 }
 
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::GetPrevPageId() const -> page_id_t {
+  return prev_page_id_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetPrevPageId(page_id_t prev_page_id) {
+  prev_page_id_ = prev_page_id;
+}
+
 /*
  * Helper method to find and return the key associated with input "index" (a.k.a
  * array offset)
  */
 INDEX_TEMPLATE_ARGUMENTS
-auto B_PLUS_TREE_LEAF_PAGE_TYPE::KeyAt(int index) const -> KeyType {
-  return key_array_[index];
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::KeyAt(int index) const -> const KeyType & {
+  return KeyArray()[index];
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::RidAt(int index) const -> ValueRef {
+  if constexpr (SLOTTED) {
+    return Codec::Decode(data_ + SlotArray()[index].offset_);
+  } else {
+    return RidArray()[index];
+  }
 }
 
 INDEX_TEMPLATE_ARGUMENTS
-auto B_PLUS_TREE_LEAF_PAGE_TYPE::RidAt(int index) const -> ValueType {
-  return rid_array_[index];
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::RidAtMut(int index) -> ValueType &
+  requires(!SLOTTED) {
+  return RidArray()[index];
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::SetKeyAt(int index, const KeyType &key) {
-  key_array_[index] = key;
+  KeyArray()[index] = key;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_LEAF_PAGE_TYPE::SetRidAt(int index, const ValueType &value) {
-  rid_array_[index] = value;
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::SetRidAt(int index, const ValueType &value)
+    -> bool {
+  if constexpr (SLOTTED) {
+    auto &slot = SlotArray()[index];
+    int length = Codec::Size(value);
+    if (length > slot.length_) {
+      if (Load() - slot.length_ + length > Capacity()) {
+        return false;
+      }
+      heap_used_ -= slot.length_;
+      slot.length_ = 0;
+      if (FreeGap() < length) {
+        Compact();
+      }
+      heap_top_ -= length;
+      slot.offset_ = heap_top_;
+    } else {
+      heap_used_ -= slot.length_;
+    }
+    slot.length_ = length;
+    heap_used_ += length;
+    Codec::Encode(value, data_ + slot.offset_);
+  } else {
+    RidArray()[index] = value;
+  }
+  return true;
+}
+
+/**
+ * @brief Insert key & value before index, shifting the later entries back
+ *
+ * On slotted pages the slot directory first moves up by one key to make room
+ * in the key column, then the payload is appended to the heap.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::InsertAt(int index, const KeyType &key,
+                                          const ValueType &value) {
+  int size = GetSize();
+  if constexpr (SLOTTED) {
+    int length = Codec::Size(value);
+    if (FreeGap() < EntryCost(value)) {
+      Compact();
+    }
+    auto old_slots = SlotArray();
+    auto new_slots = reinterpret_cast<Slot *>(data_ + (size + 1) * sizeof(KeyType));
+    memmove(new_slots + index + 1, old_slots + index, (size - index) * sizeof(Slot));
+    memmove(new_slots, old_slots, index * sizeof(Slot));
+    memmove(KeyArray() + index + 1, KeyArray() + index, (size - index) * sizeof(KeyType));
+    KeyArray()[index] = key;
+    heap_top_ -= length;
+    heap_used_ += length;
+    new_slots[index] = Slot{heap_top_, static_cast<uint16_t>(length)};
+    Codec::Encode(value, data_ + heap_top_);
+  } else {
+    memmove(KeyArray() + index + 1, KeyArray() + index, (size - index) * sizeof(KeyType));
+    memmove(RidArray() + index + 1, RidArray() + index, (size - index) * sizeof(ValueType));
+    KeyArray()[index] = key;
+    RidArray()[index] = value;
+  }
+  SetSize(size + 1);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::RemoveAt(int index) {
+  int size = GetSize();
+  if constexpr (SLOTTED) {
+    auto old_slots = SlotArray();
+    heap_used_ -= old_slots[index].length_;
+    auto new_slots = reinterpret_cast<Slot *>(data_ + (size - 1) * sizeof(KeyType));
+    memmove(KeyArray() + index, KeyArray() + index + 1, (size - 1 - index) * sizeof(KeyType));
+    memmove(new_slots, old_slots, index * sizeof(Slot));
+    memmove(new_slots + index, old_slots + index + 1, (size - 1 - index) * sizeof(Slot));
+    if (heap_used_ == 0) {
+      heap_top_ = LEAF_PAGE_DATA_SIZE;
+    }
+  } else {
+    memmove(KeyArray() + index, KeyArray() + index + 1, (size - 1 - index) * sizeof(KeyType));
+    memmove(RidArray() + index, RidArray() + index + 1, (size - 1 - index) * sizeof(ValueType));
+  }
+  SetSize(size - 1);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::Assign(const sjtu::vector<KeyType> &keys,
+                                        const sjtu::vector<ValueType> &values,
+                                        int begin, int size) {
+  if constexpr (SLOTTED) {
+    SetSize(0);
+    heap_top_ = LEAF_PAGE_DATA_SIZE;
+    heap_used_ = 0;
+    for (int i = 0; i < size; ++i) {
+      InsertAt(i, keys[begin + i], values[begin + i]);
+    }
+  } else {
+    SetSize(size);
+    memcpy(KeyArray(), &keys[begin], size * sizeof(KeyType));
+    memcpy(RidArray(), &values[begin], size * sizeof(ValueType));
+  }
+}
+
+/**
+ * @brief Move the tail of this page to the end of recipient
+ *
+ * Keys and fixed-width values are copied as blocks. Slotted payloads are
+ * copied as their encoded bytes, the slot directory of each page moves with
+ * the end of its key column.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveTailTo(BPlusTreeLeafPage *recipient, int begin) {
+  int size = GetSize();
+  int recipient_size = recipient->GetSize();
+  int n = size - begin;
+  if constexpr (SLOTTED) {
+    int payload = 0;
+    auto slots = SlotArray();
+    for (int i = begin; i < size; ++i) {
+      payload += slots[i].length_;
+    }
+    if (recipient->FreeGap() < n * static_cast<int>(sizeof(KeyType) + sizeof(Slot)) + payload) {
+      recipient->Compact();
+    }
+    auto old_slots = recipient->SlotArray();
+    auto new_slots =
+        reinterpret_cast<Slot *>(recipient->data_ + (recipient_size + n) * sizeof(KeyType));
+    memmove(new_slots, old_slots, recipient_size * sizeof(Slot));
+    memcpy(recipient->KeyArray() + recipient_size, KeyArray() + begin, n * sizeof(KeyType));
+    for (int i = 0; i < n; ++i) {
+      auto length = slots[begin + i].length_;
+      recipient->heap_top_ -= length;
+      memcpy(recipient->data_ + recipient->heap_top_, data_ + slots[begin + i].offset_, length);
+      new_slots[recipient_size + i] = Slot{recipient->heap_top_, length};
+    }
+    recipient->heap_used_ += payload;
+    recipient->SetSize(recipient_size + n);
+
+    heap_used_ -= payload;
+    memmove(data_ + begin * sizeof(KeyType), slots, begin * sizeof(Slot));
+    SetSize(begin);
+    if (heap_used_ == 0) {
+      heap_top_ = LEAF_PAGE_DATA_SIZE;
+    }
+  } else {
+    memcpy(recipient->KeyArray() + recipient_size, KeyArray() + begin, n * sizeof(KeyType));
+    memcpy(recipient->RidArray() + recipient_size, RidArray() + begin, n * sizeof(ValueType));
+    recipient->SetSize(recipient_size + n);
+    SetSize(begin);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::EntryCost(const ValueType &value) -> int {
+  if constexpr (SLOTTED) {
+    return static_cast<int>(sizeof(KeyType) + sizeof(Slot)) + Codec::Size(value);
+  } else {
+    return 1;
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::EntryCostAt(int index) const -> int {
+  if constexpr (SLOTTED) {
+    return static_cast<int>(sizeof(KeyType) + sizeof(Slot)) + SlotArray()[index].length_;
+  } else {
+    return 1;
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::Capacity() const -> int {
+  if constexpr (SLOTTED) {
+    return LEAF_PAGE_DATA_SIZE;
+  } else {
+    return GetMaxSize();
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::Load() const -> int {
+  if constexpr (SLOTTED) {
+    return GetSize() * static_cast<int>(sizeof(KeyType) + sizeof(Slot)) + heap_used_;
+  } else {
+    return GetSize();
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::MinLoad() const -> int {
+  if constexpr (SLOTTED) {
+    return Capacity() / 2;
+  } else {
+    return GetMinSize();
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::CanHold(const ValueType &value) const -> bool {
+  return Load() + EntryCost(value) <= Capacity();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::FreeGap() const -> int {
+  return heap_top_ - GetSize() * static_cast<int>(sizeof(KeyType) + sizeof(Slot));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::Compact() {
+  char heap[LEAF_PAGE_DATA_SIZE];
+  int top = LEAF_PAGE_DATA_SIZE;
+  auto slots = SlotArray();
+  for (int i = 0; i < GetSize(); ++i) {
+    top -= slots[i].length_;
+    memcpy(heap + top, data_ + slots[i].offset_, slots[i].length_);
+    slots[i].offset_ = top;
+  }
+  memcpy(data_ + top, heap + top, LEAF_PAGE_DATA_SIZE - top);
+  heap_top_ = top;
 }
 
 template class BPlusTreeLeafPage<hash_t, UserInfo, HashComp, HashComp>;
 template class BPlusTreeLeafPage<
   TrainDate, TicketDateInfo, PairCompare<TrainDate>, PairDegradedCompare<
     TrainDate> >;
+template class BPlusTreeLeafPage<
+  TrainDate, RID, PairCompare<TrainDate>, PairDegradedCompare<TrainDate> >;
 template class BPlusTreeLeafPage<
   TrainDateOrder, PendingInfo, TDOCompare, TDODegradedCompare>;
 template class BPlusTreeLeafPage<
@@ -0,0 +1,105 @@
+#include "storage/bloom_filter.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace sjtu {
+namespace {
+constexpr int BLOOM_WORDS_PER_PAGE = SJTU_PAGE_SIZE / sizeof(uint64_t);
+
+// About ln 2 * bits_per_key probes minimize the false positive rate.
+auto BloomHashCount(int bits_per_key) -> int {
+  return std::clamp(bits_per_key * 69 / 100, 1, 16);
+}
+
+auto BloomWordCount(int capacity, int bits_per_key) -> int {
+  return static_cast<int>((static_cast<int64_t>(capacity) * bits_per_key + 63) / 64);
+}
+}  // namespace
+
+void BloomFilter::Reset(int capacity, int bits_per_key) {
+  capacity_ = std::max(capacity, 1);
+  hash_cnt_ = BloomHashCount(bits_per_key);
+  bits_ = sjtu::vector<uint64_t>(BloomWordCount(capacity_, bits_per_key), 0);
+  key_cnt_ = 0;
+  removed_cnt_ = 0;
+}
+
+/**
+ * Probes are derived from two halves of the hash (double hashing), so one
+ * hash per key is enough for any number of probes.
+ */
+void BloomFilter::Add(uint64_t hash) {
+  uint64_t bit_cnt = bits_.size() * 64;
+  uint64_t delta = (hash >> 32) | (hash << 32) | 1;
+  for (int i = 0; i < hash_cnt_; ++i) {
+    auto bit = hash % bit_cnt;
+    bits_[bit / 64] |= 1ULL << (bit % 64);
+    hash += delta;
+  }
+  ++key_cnt_;
+}
+
+auto BloomFilter::MayContain(uint64_t hash) const -> bool {
+  uint64_t bit_cnt = bits_.size() * 64;
+  uint64_t delta = (hash >> 32) | (hash << 32) | 1;
+  for (int i = 0; i < hash_cnt_; ++i) {
+    auto bit = hash % bit_cnt;
+    if ((bits_[bit / 64] & (1ULL << (bit % 64))) == 0) {
+      return false;
+    }
+    hash += delta;
+  }
+  return true;
+}
+
+auto BloomFilter::NeedsRebuild() const -> bool {
+  return key_cnt_ > capacity_ || removed_cnt_ * 2 > std::max(key_cnt_, 1);
+}
+
+auto BloomFilter::Load(BufferPoolManager *bpm, const BloomFilterHeader &header,
+                       int bits_per_key) -> bool {
+  if (header.clean_ == 0 || header.hash_cnt_ != BloomHashCount(bits_per_key) ||
+      header.word_cnt_ != BloomWordCount(header.capacity_, bits_per_key)) {
+    return false;
+  }
+  capacity_ = header.capacity_;
+  hash_cnt_ = header.hash_cnt_;
+  key_cnt_ = header.key_cnt_;
+  removed_cnt_ = header.removed_cnt_;
+  bits_ = sjtu::vector<uint64_t>(header.word_cnt_, 0);
+  for (int i = 0; i < header.page_cnt_; ++i) {
+    int begin = i * BLOOM_WORDS_PER_PAGE;
+    int count = std::min(BLOOM_WORDS_PER_PAGE, header.word_cnt_ - begin);
+    auto guard = bpm->ReadPage(header.page_id_ + i);
+    memcpy(&bits_[begin], guard.GetData(), count * sizeof(uint64_t));
+  }
+  return true;
+}
+
+void BloomFilter::Save(BufferPoolManager *bpm, BloomFilterHeader *header) const {
+  int word_cnt = static_cast<int>(bits_.size());
+  int page_cnt = (word_cnt + BLOOM_WORDS_PER_PAGE - 1) / BLOOM_WORDS_PER_PAGE;
+  if (page_cnt > header->page_cnt_) {
+    // Pages are never given back, a filter that outgrew its pages moves to a
+    // fresh run and leaves the old one behind.
+    header->page_id_ = bpm->NewPage();
+    for (int i = 1; i < page_cnt; ++i) {
+      bpm->NewPage();
+    }
+    header->page_cnt_ = page_cnt;
+  }
+  for (int i = 0; i < page_cnt; ++i) {
+    int begin = i * BLOOM_WORDS_PER_PAGE;
+    int count = std::min(BLOOM_WORDS_PER_PAGE, word_cnt - begin);
+    auto guard = bpm->WritePage(header->page_id_ + i);
+    memcpy(guard.GetDataMut(), &bits_[begin], count * sizeof(uint64_t));
+  }
+  header->word_cnt_ = word_cnt;
+  header->hash_cnt_ = hash_cnt_;
+  header->capacity_ = capacity_;
+  header->key_cnt_ = key_cnt_;
+  header->removed_cnt_ = removed_cnt_;
+  header->clean_ = 1;
+}
+}  // namespace sjtu
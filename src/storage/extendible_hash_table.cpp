@@ -0,0 +1,261 @@
+#include "storage/extendible_hash_table.h"
+
+#include "management/train.h"
+#include "management/user.h"
+
+namespace sjtu {
+HTABLE_TEMPLATE_ARGUMENTS
+EXTENDIBLE_HASH_TABLE_TYPE::ExtendibleHashTable(std::string name,
+                                                const KeyComparator &comparator,
+                                                int bpm_max_size, int header_max_depth,
+                                                int directory_max_depth, int bucket_max_size)
+  : index_name_(std::move(name)),
+    comparator_(comparator),
+    directory_max_depth_(directory_max_depth),
+    bucket_max_size_(bucket_max_size) {
+  bpm_ = new BufferPoolManager(bpm_max_size, index_name_);
+  header_page_id_ = bpm_->NewPage();
+  auto guard = bpm_->WritePage(header_page_id_);
+  auto header_page = guard.template AsMut<ExtendibleHTableHeaderPage>();
+  if (!header_page->IsInitialized()) {
+    header_page->Init(header_max_depth);
+  } else {
+    bpm_->SetNextPageId(header_page->next_page_id_);
+  }
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+EXTENDIBLE_HASH_TABLE_TYPE::~ExtendibleHashTable() {
+  bpm_->WritePage(header_page_id_).template AsMut<ExtendibleHTableHeaderPage>()->
+      next_page_id_ = bpm_->GetNextPageId();
+  delete bpm_;
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HASH_TABLE_TYPE::IsEmpty() const -> bool {
+  return bpm_->ReadPage(header_page_id_).template As<ExtendibleHTableHeaderPage>()->entry_cnt_ == 0;
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HASH_TABLE_TYPE::Insert(const KeyType &key, const ValueType &value) -> bool {
+  return InsertImpl(key, value, false);
+}
+
+/**
+ * @return true if a new entry was inserted, false if an existing one was
+ * overwritten (or the entry could not be inserted)
+ */
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HASH_TABLE_TYPE::Upsert(const KeyType &key, const ValueType &value) -> bool {
+  return InsertImpl(key, value, true);
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HASH_TABLE_TYPE::InsertImpl(const KeyType &key, const ValueType &value,
+                                            bool overwrite) -> bool {
+  auto hash = Hash(key);
+  auto header_guard = bpm_->WritePage(header_page_id_);
+  auto header_page = header_guard.template AsMut<ExtendibleHTableHeaderPage>();
+  auto directory_idx = header_page->HashToDirectoryIndex(hash);
+  auto directory_page_id = header_page->GetDirectoryPageId(directory_idx);
+  if (directory_page_id == INVALID_PAGE_ID) {
+    directory_page_id = bpm_->NewPage();
+    auto bucket_page_id = NewBucketPage();
+    auto directory_guard = bpm_->WritePage(directory_page_id);
+    auto directory_page = directory_guard.template AsMut<ExtendibleHTableDirectoryPage>();
+    directory_page->Init(directory_max_depth_);
+    directory_page->SetBucketPageId(0, bucket_page_id);
+    header_page->SetDirectoryPageId(directory_idx, directory_page_id);
+  }
+
+  auto directory_guard = bpm_->WritePage(directory_page_id);
+  auto directory_page = directory_guard.template AsMut<ExtendibleHTableDirectoryPage>();
+  while (true) {
+    auto bucket_idx = directory_page->HashToBucketIndex(hash);
+    auto bucket_guard = bpm_->WritePage(directory_page->GetBucketPageId(bucket_idx));
+    auto bucket_page = bucket_guard.template AsMut<BucketPage>();
+    auto index = bucket_page->Lookup(key, comparator_);
+    if (index >= 0) {
+      if (overwrite) {
+        bucket_page->ValueAtMut(index) = value;
+      }
+      return false;
+    }
+    if (!bucket_page->IsFull()) {
+      bucket_page->InsertAt(key, value);
+      ++header_page->entry_cnt_;
+      return true;
+    }
+    bucket_guard.Drop();
+    // All entries of a bucket may share the split bit, so splitting once does
+    // not guarantee room.
+    if (!SplitBucket(directory_page, bucket_idx)) {
+      return false;
+    }
+  }
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HASH_TABLE_TYPE::Remove(const KeyType &key) -> bool {
+  auto hash = Hash(key);
+  auto header_guard = bpm_->WritePage(header_page_id_);
+  auto header_page = header_guard.template AsMut<ExtendibleHTableHeaderPage>();
+  auto directory_page_id =
+      header_page->GetDirectoryPageId(header_page->HashToDirectoryIndex(hash));
+  if (directory_page_id == INVALID_PAGE_ID) {
+    return false;
+  }
+  auto directory_guard = bpm_->WritePage(directory_page_id);
+  auto directory_page = directory_guard.template AsMut<ExtendibleHTableDirectoryPage>();
+  auto bucket_idx = directory_page->HashToBucketIndex(hash);
+  auto bucket_guard = bpm_->WritePage(directory_page->GetBucketPageId(bucket_idx));
+  auto bucket_page = bucket_guard.template AsMut<BucketPage>();
+  auto index = bucket_page->Lookup(key, comparator_);
+  if (index < 0) {
+    return false;
+  }
+  bucket_page->RemoveAt(index);
+  --header_page->entry_cnt_;
+  bool empty = bucket_page->IsEmpty();
+  bucket_guard.Drop();
+  if (empty) {
+    MergeBuckets(directory_page, bucket_idx);
+  }
+  return true;
+}
+
+/**
+ * @brief Return the only value that associated with input key
+ *
+ * Reads the header, the directory and the bucket page, the first two of
+ * which stay hot in the buffer pool.
+ *
+ * @return true means key exists
+ */
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HASH_TABLE_TYPE::GetValue(const KeyType &key,
+                                          sjtu::vector<ValueType> *result) -> bool {
+  auto bucket_page_id = FindBucketPageId(Hash(key));
+  if (bucket_page_id == INVALID_PAGE_ID) {
+    return false;
+  }
+  auto bucket_guard = bpm_->ReadPage(bucket_page_id);
+  auto bucket_page = bucket_guard.template As<BucketPage>();
+  auto index = bucket_page->Lookup(key, comparator_);
+  if (index < 0) {
+    return false;
+  }
+  result->push_back(bucket_page->ValueAt(index));
+  return true;
+}
+
+/*****************************************************************************
+ * UTILITIES AND HELPERS
+ *****************************************************************************/
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HASH_TABLE_TYPE::Hash(const KeyType &key) const -> uint32_t {
+  return static_cast<uint32_t>(KeyHash(key));
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HASH_TABLE_TYPE::FindBucketPageId(uint32_t hash) -> page_id_t {
+  auto header_guard = bpm_->ReadPage(header_page_id_);
+  auto header_page = header_guard.template As<ExtendibleHTableHeaderPage>();
+  auto directory_page_id =
+      header_page->GetDirectoryPageId(header_page->HashToDirectoryIndex(hash));
+  if (directory_page_id == INVALID_PAGE_ID) {
+    return INVALID_PAGE_ID;
+  }
+  header_guard.Drop();
+  auto directory_guard = bpm_->ReadPage(directory_page_id);
+  auto directory_page = directory_guard.template As<ExtendibleHTableDirectoryPage>();
+  return directory_page->GetBucketPageId(directory_page->HashToBucketIndex(hash));
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HASH_TABLE_TYPE::NewBucketPage() -> page_id_t {
+  auto bucket_page_id = bpm_->NewPage();
+  bpm_->WritePage(bucket_page_id).template AsMut<BucketPage>()->Init(bucket_max_size_);
+  return bucket_page_id;
+}
+
+/**
+ * The bucket of local depth d becomes two buckets of local depth d + 1: the
+ * directory slots and entries whose hash has bit d set move to a new page.
+ */
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HASH_TABLE_TYPE::SplitBucket(ExtendibleHTableDirectoryPage *directory,
+                                             uint32_t bucket_idx) -> bool {
+  auto local_depth = directory->GetLocalDepth(bucket_idx);
+  if (local_depth == directory->GetGlobalDepth()) {
+    if (local_depth >= directory->GetMaxDepth()) {
+      return false;
+    }
+    directory->IncrGlobalDepth();
+  }
+  auto old_page_id = directory->GetBucketPageId(bucket_idx);
+  auto new_page_id = NewBucketPage();
+  uint32_t split_bit = 1U << local_depth;
+  for (uint32_t i = 0; i < directory->Size(); ++i) {
+    if (directory->GetBucketPageId(i) == old_page_id) {
+      directory->SetLocalDepth(i, local_depth + 1);
+      if ((i & split_bit) != 0) {
+        directory->SetBucketPageId(i, new_page_id);
+      }
+    }
+  }
+
+  auto old_guard = bpm_->WritePage(old_page_id);
+  auto new_guard = bpm_->WritePage(new_page_id);
+  auto old_page = old_guard.template AsMut<BucketPage>();
+  auto new_page = new_guard.template AsMut<BucketPage>();
+  for (int i = 0; i < old_page->Size();) {
+    if ((Hash(old_page->KeyAt(i)) & split_bit) != 0) {
+      new_page->InsertAt(old_page->KeyAt(i), old_page->ValueAt(i));
+      old_page->RemoveAt(i);
+    } else {
+      ++i;
+    }
+  }
+  return true;
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+void EXTENDIBLE_HASH_TABLE_TYPE::MergeBuckets(ExtendibleHTableDirectoryPage *directory,
+                                              uint32_t bucket_idx) {
+  while (true) {
+    auto local_depth = directory->GetLocalDepth(bucket_idx);
+    if (local_depth == 0) {
+      return;
+    }
+    auto image_idx = directory->GetSplitImageIndex(bucket_idx);
+    if (directory->GetLocalDepth(image_idx) != local_depth) {
+      return;
+    }
+    auto page_id = directory->GetBucketPageId(bucket_idx);
+    auto image_page_id = directory->GetBucketPageId(image_idx);
+    bool empty = bpm_->ReadPage(page_id).template As<BucketPage>()->IsEmpty();
+    bool image_empty = bpm_->ReadPage(image_page_id).template As<BucketPage>()->IsEmpty();
+    if (!empty && !image_empty) {
+      return;
+    }
+    auto keep_page_id = empty ? image_page_id : page_id;
+    for (uint32_t i = 0; i < directory->Size(); ++i) {
+      auto cur_page_id = directory->GetBucketPageId(i);
+      if (cur_page_id == page_id || cur_page_id == image_page_id) {
+        directory->SetBucketPageId(i, keep_page_id);
+        directory->SetLocalDepth(i, local_depth - 1);
+      }
+    }
+    bpm_->DeletePage(empty ? page_id : image_page_id);
+    while (directory->CanShrink()) {
+      directory->DecrGlobalDepth();
+    }
+    bucket_idx &= (1U << (local_depth - 1)) - 1;
+  }
+}
+
+template class ExtendibleHashTable<hash_t, UserInfo, HashComp>;
+// station and train ids
+template class ExtendibleHashTable<hash_t, uint32_t, HashComp>;
+}  // namespace sjtu
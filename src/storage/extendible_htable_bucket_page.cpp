@@ -0,0 +1,72 @@
+#include "storage/extendible_htable_bucket_page.h"
+
+#include "management/train.h"
+#include "management/user.h"
+
+namespace sjtu {
+HTABLE_TEMPLATE_ARGUMENTS
+void EXTENDIBLE_HTABLE_BUCKET_PAGE_TYPE::Init(int max_size) {
+  size_ = 0;
+  max_size_ = max_size;
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HTABLE_BUCKET_PAGE_TYPE::Lookup(const KeyType &key,
+                                                const KeyComparator &cmp) const -> int {
+  for (int i = 0; i < size_; ++i) {
+    if (cmp(array_[i].first, key) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+void EXTENDIBLE_HTABLE_BUCKET_PAGE_TYPE::InsertAt(const KeyType &key, const ValueType &value) {
+  array_[size_].first = key;
+  array_[size_].second = value;
+  ++size_;
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+void EXTENDIBLE_HTABLE_BUCKET_PAGE_TYPE::RemoveAt(int index) {
+  --size_;
+  if (index != size_) {
+    array_[index] = array_[size_];
+  }
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HTABLE_BUCKET_PAGE_TYPE::KeyAt(int index) const -> const KeyType & {
+  return array_[index].first;
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HTABLE_BUCKET_PAGE_TYPE::ValueAt(int index) const -> const ValueType & {
+  return array_[index].second;
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HTABLE_BUCKET_PAGE_TYPE::ValueAtMut(int index) -> ValueType & {
+  return array_[index].second;
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HTABLE_BUCKET_PAGE_TYPE::Size() const -> int {
+  return size_;
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HTABLE_BUCKET_PAGE_TYPE::IsFull() const -> bool {
+  return size_ >= max_size_;
+}
+
+HTABLE_TEMPLATE_ARGUMENTS
+auto EXTENDIBLE_HTABLE_BUCKET_PAGE_TYPE::IsEmpty() const -> bool {
+  return size_ == 0;
+}
+
+template class ExtendibleHTableBucketPage<hash_t, UserInfo, HashComp>;
+// station and train ids
+template class ExtendibleHTableBucketPage<hash_t, uint32_t, HashComp>;
+}  // namespace sjtu
@@ -0,0 +1,74 @@
+#include "storage/extendible_htable_directory_page.h"
+
+#include <algorithm>
+
+namespace sjtu {
+void ExtendibleHTableDirectoryPage::Init(int max_depth) {
+  max_depth_ = std::clamp(max_depth, 0, HTABLE_DIRECTORY_MAX_DEPTH);
+  global_depth_ = 0;
+  local_depths_[0] = 0;
+  bucket_page_ids_[0] = INVALID_PAGE_ID;
+}
+
+auto ExtendibleHTableDirectoryPage::HashToBucketIndex(uint32_t hash) const -> uint32_t {
+  return hash & (Size() - 1);
+}
+
+auto ExtendibleHTableDirectoryPage::GetBucketPageId(uint32_t bucket_idx) const -> page_id_t {
+  return bucket_page_ids_[bucket_idx];
+}
+
+void ExtendibleHTableDirectoryPage::SetBucketPageId(uint32_t bucket_idx,
+                                                    page_id_t bucket_page_id) {
+  bucket_page_ids_[bucket_idx] = bucket_page_id;
+}
+
+auto ExtendibleHTableDirectoryPage::GetSplitImageIndex(uint32_t bucket_idx) const -> uint32_t {
+  return bucket_idx ^ (1U << (local_depths_[bucket_idx] - 1));
+}
+
+auto ExtendibleHTableDirectoryPage::GetGlobalDepth() const -> int {
+  return global_depth_;
+}
+
+auto ExtendibleHTableDirectoryPage::GetMaxDepth() const -> int {
+  return max_depth_;
+}
+
+void ExtendibleHTableDirectoryPage::IncrGlobalDepth() {
+  auto size = Size();
+  for (uint32_t i = 0; i < size; ++i) {
+    local_depths_[i + size] = local_depths_[i];
+    bucket_page_ids_[i + size] = bucket_page_ids_[i];
+  }
+  ++global_depth_;
+}
+
+void ExtendibleHTableDirectoryPage::DecrGlobalDepth() {
+  --global_depth_;
+}
+
+auto ExtendibleHTableDirectoryPage::CanShrink() const -> bool {
+  if (global_depth_ == 0) {
+    return false;
+  }
+  for (uint32_t i = 0; i < Size(); ++i) {
+    if (local_depths_[i] == global_depth_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+auto ExtendibleHTableDirectoryPage::Size() const -> uint32_t {
+  return 1U << global_depth_;
+}
+
+auto ExtendibleHTableDirectoryPage::GetLocalDepth(uint32_t bucket_idx) const -> int {
+  return local_depths_[bucket_idx];
+}
+
+void ExtendibleHTableDirectoryPage::SetLocalDepth(uint32_t bucket_idx, int local_depth) {
+  local_depths_[bucket_idx] = static_cast<uint8_t>(local_depth);
+}
+}  // namespace sjtu
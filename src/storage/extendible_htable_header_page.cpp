@@ -0,0 +1,34 @@
+#include "storage/extendible_htable_header_page.h"
+
+#include <algorithm>
+
+namespace sjtu {
+void ExtendibleHTableHeaderPage::Init(int max_depth) {
+  max_depth_ = std::clamp(max_depth, 1, HTABLE_HEADER_MAX_DEPTH);
+  entry_cnt_ = 0;
+  for (uint32_t i = 0; i < MaxSize(); ++i) {
+    directory_page_ids_[i] = INVALID_PAGE_ID;
+  }
+}
+
+/**
+ * The directory is picked by the upper bits of the hash, the directory then
+ * uses the lower bits to pick a bucket.
+ */
+auto ExtendibleHTableHeaderPage::HashToDirectoryIndex(uint32_t hash) const -> uint32_t {
+  return hash >> (32 - max_depth_);
+}
+
+auto ExtendibleHTableHeaderPage::GetDirectoryPageId(uint32_t directory_idx) const -> page_id_t {
+  return directory_page_ids_[directory_idx];
+}
+
+void ExtendibleHTableHeaderPage::SetDirectoryPageId(uint32_t directory_idx,
+                                                    page_id_t directory_page_id) {
+  directory_page_ids_[directory_idx] = directory_page_id;
+}
+
+auto ExtendibleHTableHeaderPage::MaxSize() const -> uint32_t {
+  return 1U << max_depth_;
+}
+}  // namespace sjtu
@@ -0,0 +1,116 @@
+#include "storage/heap_b_plus_tree.h"
+
+#include "management/ticket.h"
+
+namespace sjtu {
+INDEX_TEMPLATE_ARGUMENTS
+HEAP_BPLUSTREE_TYPE::HeapBPlusTree(const std::string &name,
+                                   const KeyComparator &comparator,
+                                   const DegradedKeyComparator &degraded_comparator,
+                                   int bpm_max_size)
+  : index_(name, comparator, degraded_comparator, bpm_max_size),
+    heap_(name + "_heap", bpm_max_size),
+    comparator_(comparator) {}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto HEAP_BPLUSTREE_TYPE::IsEmpty() const -> bool { return index_.IsEmpty(); }
+
+INDEX_TEMPLATE_ARGUMENTS
+auto HEAP_BPLUSTREE_TYPE::FindRid(const KeyType &key, RID *rid) -> bool {
+  sjtu::vector<RID> rids;
+  if (!index_.GetValue(key, &rids)) {
+    return false;
+  }
+  *rid = rids[0];
+  return true;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto HEAP_BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value) -> bool {
+  auto rid = heap_.Insert(value);
+  if (!index_.Insert(key, rid)) {
+    heap_.Remove(rid);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @return true if a new entry was inserted, false if an existing one was
+ * overwritten
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto HEAP_BPLUSTREE_TYPE::Upsert(const KeyType &key, const ValueType &value) -> bool {
+  RID rid;
+  if (!FindRid(key, &rid)) {
+    index_.Insert(key, heap_.Insert(value));
+    return true;
+  }
+  auto new_rid = heap_.Update(rid, value);
+  if (!(new_rid == rid)) {
+    index_.Upsert(key, new_rid);
+  }
+  return false;
+}
+
+/**
+ * @brief Append the new values to the heap in key order, then index them with
+ * one BPlusTree::InsertBatch
+ *
+ * @return number of entries inserted
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto HEAP_BPLUSTREE_TYPE::InsertBatch(const sjtu::vector<KeyType> &keys,
+                                      const sjtu::vector<ValueType> &values) -> int {
+  sjtu::vector<KeyType> new_keys;
+  sjtu::vector<RID> rids;
+  RID rid;
+  for (int i = 0; i < keys.size(); ++i) {
+    if ((i > 0 && comparator_(keys[i - 1], keys[i]) == 0) || FindRid(keys[i], &rid)) {
+      continue;
+    }
+    new_keys.push_back(keys[i]);
+    rids.push_back(heap_.Insert(values[i]));
+  }
+  return index_.InsertBatch(new_keys, rids);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void HEAP_BPLUSTREE_TYPE::Remove(const KeyType &key) {
+  RID rid;
+  if (!FindRid(key, &rid)) {
+    return;
+  }
+  index_.Remove(key);
+  heap_.Remove(rid);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto HEAP_BPLUSTREE_TYPE::GetValue(const KeyType &key, sjtu::vector<ValueType> *result) -> bool {
+  RID rid;
+  if (!FindRid(key, &rid)) {
+    return false;
+  }
+  result->push_back(heap_.Get(rid));
+  return true;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto HEAP_BPLUSTREE_TYPE::MultiGet(const sjtu::vector<KeyType> &keys,
+                                   sjtu::vector<std::optional<ValueType> > *result) -> int {
+  sjtu::vector<std::optional<RID> > rids;
+  int found = index_.MultiGet(keys, &rids);
+  result->clear();
+  for (int i = 0; i < rids.size(); ++i) {
+    if (rids[i].has_value()) {
+      result->push_back(heap_.Get(*rids[i]));
+    } else {
+      result->push_back(std::nullopt);
+    }
+  }
+  return found;
+}
+
+template class HeapBPlusTree<TrainDate, TicketDateInfo, PairCompare<TrainDate>,
+                             PairDegradedCompare<TrainDate> >;
+} // namespace sjtu
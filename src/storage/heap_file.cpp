@@ -0,0 +1,107 @@
+#include "storage/heap_file.h"
+
+#include <cstring>
+
+#include "management/ticket.h"
+
+namespace sjtu {
+template <typename ValueType>
+HeapFile<ValueType>::HeapFile(const std::string &name, int bpm_max_size) {
+  bpm_ = new BufferPoolManager(bpm_max_size, name);
+  header_page_id_ = bpm_->NewPage();
+  auto guard = bpm_->WritePage(header_page_id_);
+  auto header_page = guard.AsMut<HeapFileHeaderPage>();
+  if (header_page->last_page_id_ == 0) {
+    header_page->last_page_id_ = INVALID_PAGE_ID;
+  } else {
+    bpm_->SetNextPageId(header_page->next_page_id_);
+  }
+}
+
+template <typename ValueType>
+HeapFile<ValueType>::~HeapFile() {
+  bpm_->WritePage(header_page_id_).AsMut<HeapFileHeaderPage>()->next_page_id_ = bpm_->GetNextPageId();
+  delete bpm_;
+}
+
+template <typename ValueType>
+auto HeapFile<ValueType>::Insert(const ValueType &value) -> RID {
+  char record[SJTU_PAGE_SIZE];
+  int length = RecordSize(value);
+  Encode(value, record);
+  auto header_guard = bpm_->WritePage(header_page_id_);
+  auto header_page = header_guard.AsMut<HeapFileHeaderPage>();
+  if (header_page->last_page_id_ != INVALID_PAGE_ID) {
+    auto guard = bpm_->WritePage(header_page->last_page_id_);
+    auto slot = guard.AsMut<HeapPage>()->Insert(record, length);
+    if (slot >= 0) {
+      return RID(header_page->last_page_id_, slot);
+    }
+  }
+  header_page->last_page_id_ = bpm_->NewPage();
+  auto guard = bpm_->WritePage(header_page->last_page_id_);
+  auto page = guard.AsMut<HeapPage>();
+  page->Init();
+  return RID(header_page->last_page_id_, page->Insert(record, length));
+}
+
+template <typename ValueType>
+auto HeapFile<ValueType>::Get(const RID &rid) -> ValueType {
+  auto guard = bpm_->ReadPage(rid.GetPageId());
+  int length;
+  return Decode(guard.As<HeapPage>()->Get(rid.GetSlotNum(), &length));
+}
+
+template <typename ValueType>
+auto HeapFile<ValueType>::Update(const RID &rid, const ValueType &value) -> RID {
+  char record[SJTU_PAGE_SIZE];
+  int length = RecordSize(value);
+  Encode(value, record);
+  {
+    auto guard = bpm_->WritePage(rid.GetPageId());
+    auto page = guard.AsMut<HeapPage>();
+    if (page->Update(rid.GetSlotNum(), record, length)) {
+      return rid;
+    }
+    page->Remove(rid.GetSlotNum());
+  }
+  return Insert(value);
+}
+
+template <typename ValueType>
+void HeapFile<ValueType>::Remove(const RID &rid) {
+  auto guard = bpm_->WritePage(rid.GetPageId());
+  guard.AsMut<HeapPage>()->Remove(rid.GetSlotNum());
+}
+
+template <typename ValueType>
+auto HeapFile<ValueType>::RecordSize(const ValueType &value) -> int {
+  if constexpr (Codec::VARIABLE_LENGTH) {
+    return Codec::Size(value);
+  } else {
+    return sizeof(ValueType);
+  }
+}
+
+template <typename ValueType>
+void HeapFile<ValueType>::Encode(const ValueType &value, char *dst) {
+  if constexpr (Codec::VARIABLE_LENGTH) {
+    Codec::Encode(value, dst);
+  } else {
+    memcpy(dst, &value, sizeof(ValueType));
+  }
+}
+
+template <typename ValueType>
+auto HeapFile<ValueType>::Decode(const char *src) -> ValueType {
+  if constexpr (Codec::VARIABLE_LENGTH) {
+    return Codec::Decode(src);
+  } else {
+    ValueType value;
+    memcpy(&value, src, sizeof(ValueType));
+    return value;
+  }
+}
+
+template class HeapFile<TicketDateInfo>;
+} // namespace sjtu
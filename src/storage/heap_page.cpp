@@ -0,0 +1,118 @@
+#include "storage/heap_page.h"
+
+#include <cstring>
+
+namespace sjtu {
+static constexpr int HEAP_PAGE_DATA_SIZE = SJTU_PAGE_SIZE - HEAP_PAGE_HEADER_SIZE;
+
+/**
+ * @brief Init method after creating a new heap page, leaves the page empty
+ */
+void HeapPage::Init() {
+  slot_cnt_ = 0;
+  heap_top_ = HEAP_PAGE_DATA_SIZE;
+  heap_used_ = 0;
+  free_slot_cnt_ = 0;
+}
+
+auto HeapPage::FreeSpace() const -> int {
+  return HEAP_PAGE_DATA_SIZE - (slot_cnt_ + 1) * static_cast<int>(sizeof(Slot)) - heap_used_;
+}
+
+auto HeapPage::Insert(const char *data, int length) -> int {
+  int slot = slot_cnt_;
+  if (free_slot_cnt_ > 0) {
+    for (slot = 0; SlotArray()[slot].offset_ != 0; ++slot) {
+    }
+  }
+  int need = length + (slot == slot_cnt_ ? static_cast<int>(sizeof(Slot)) : 0);
+  if (need > HEAP_PAGE_DATA_SIZE - slot_cnt_ * static_cast<int>(sizeof(Slot)) - heap_used_) {
+    return -1;
+  }
+  // make room for a new slot before claiming it, it may overlap a record
+  if (FreeGap() < need) {
+    Compact();
+  }
+  if (slot == slot_cnt_) {
+    ++slot_cnt_;
+  } else {
+    --free_slot_cnt_;
+  }
+  auto offset = Allocate(length);
+  memcpy(data_ + offset, data, length);
+  SlotArray()[slot] = Slot{offset, static_cast<uint16_t>(length)};
+  return slot;
+}
+
+auto HeapPage::Get(int slot, int *length) const -> const char * {
+  *length = SlotArray()[slot].length_;
+  return data_ + SlotArray()[slot].offset_;
+}
+
+auto HeapPage::Update(int slot, const char *data, int length) -> bool {
+  auto &cur = SlotArray()[slot];
+  if (length <= cur.length_) {
+    heap_used_ -= cur.length_ - length;
+    cur.length_ = length;
+    memcpy(data_ + cur.offset_, data, length);
+    return true;
+  }
+  if (FreeSpace() + static_cast<int>(sizeof(Slot)) + cur.length_ < length) {
+    return false;
+  }
+  heap_used_ -= cur.length_;
+  cur.length_ = 0;
+  auto offset = Allocate(length);
+  memcpy(data_ + offset, data, length);
+  cur = Slot{offset, static_cast<uint16_t>(length)};
+  return true;
+}
+
+void HeapPage::Remove(int slot) {
+  auto &cur = SlotArray()[slot];
+  heap_used_ -= cur.length_;
+  cur = Slot{0, 0};
+  if (slot + 1 == slot_cnt_) {
+    --slot_cnt_;
+    // trailing free slots are dropped rather than kept for reuse
+    while (slot_cnt_ > 0 && SlotArray()[slot_cnt_ - 1].offset_ == 0) {
+      --slot_cnt_;
+      --free_slot_cnt_;
+    }
+  } else {
+    ++free_slot_cnt_;
+  }
+  if (heap_used_ == 0) {
+    heap_top_ = HEAP_PAGE_DATA_SIZE;
+  }
+}
+
+auto HeapPage::FreeGap() const -> int {
+  return heap_top_ - slot_cnt_ * static_cast<int>(sizeof(Slot));
+}
+
+auto HeapPage::Allocate(int length) -> uint16_t {
+  if (FreeGap() < length) {
+    Compact();
+  }
+  heap_top_ -= length;
+  heap_used_ += length;
+  return heap_top_;
+}
+
+void HeapPage::Compact() {
+  char records[HEAP_PAGE_DATA_SIZE];
+  int top = HEAP_PAGE_DATA_SIZE;
+  auto slots = SlotArray();
+  for (int i = 0; i < slot_cnt_; ++i) {
+    if (slots[i].offset_ == 0) {
+      continue;
+    }
+    top -= slots[i].length_;
+    memcpy(records + top, data_ + slots[i].offset_, slots[i].length_);
+    slots[i].offset_ = top;
+  }
+  memcpy(data_ + top, records + top, HEAP_PAGE_DATA_SIZE - top);
+  heap_top_ = top;
+}
+} // namespace sjtu
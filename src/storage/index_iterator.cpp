@@ -0,0 +1,92 @@
+/**
+ * index_iterator.cpp
+ */
+#include "storage/index_iterator.h"
+
+#include "management/ticket.h"
+#include "management/train.h"
+#include "management/user.h"
+
+namespace sjtu {
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE::IndexIterator(BufferPoolManager *bpm, ReadPageGuard guard,
+                                  int index)
+  : bpm_(bpm), guard_(std::move(guard)), index_(index) {
+  page_ = guard_.template As<LeafPage>();
+  Settle();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto INDEXITERATOR_TYPE::IsEnd() const -> bool { return page_ == nullptr; }
+
+INDEX_TEMPLATE_ARGUMENTS
+auto INDEXITERATOR_TYPE::Key() const -> const KeyType & {
+  return page_->KeyAt(index_);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto INDEXITERATOR_TYPE::Value() const -> const ValueType & {
+  if constexpr (LeafPage::SLOTTED) {
+    value_.emplace(page_->RidAt(index_));
+    return *value_;
+  } else {
+    return page_->RidAt(index_);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::Next() {
+  ++index_;
+  Settle();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::Prev() {
+  --index_;
+  SettleBackward();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::Settle() {
+  while (page_ != nullptr && index_ >= page_->GetSize()) {
+    auto next_page_id = page_->GetNextPageId();
+    if (next_page_id == INVALID_PAGE_ID) {
+      guard_.Drop();
+      page_ = nullptr;
+      return;
+    }
+    guard_ = bpm_->ReadPage(next_page_id);
+    page_ = guard_.template As<LeafPage>();
+    index_ = 0;
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::SettleBackward() {
+  while (page_ != nullptr && index_ < 0) {
+    auto prev_page_id = page_->GetPrevPageId();
+    if (prev_page_id == INVALID_PAGE_ID) {
+      guard_.Drop();
+      page_ = nullptr;
+      return;
+    }
+    guard_ = bpm_->ReadPage(prev_page_id);
+    page_ = guard_.template As<LeafPage>();
+    index_ = page_->GetSize() - 1;
+  }
+}
+
+template class IndexIterator<hash_t, UserInfo, HashComp, HashComp>;
+template class IndexIterator<hash_t, TrainMeta, HashComp, HashComp>;
+template class IndexIterator<TrainDate, TicketDateInfo, PairCompare<TrainDate>,
+                             PairDegradedCompare<TrainDate> >;
+template class IndexIterator<TrainDate, RID, PairCompare<TrainDate>,
+                             PairDegradedCompare<TrainDate> >;
+template class IndexIterator<OrderTime, OrderInfo, PairCompare<OrderTime>,
+                             PairDegradedCompare<OrderTime> >;
+template class IndexIterator<TrainDateOrder, PendingInfo, TDOCompare,
+                             TDODegradedCompare>;
+template class IndexIterator<StationTrain, StationTrainInfo,
+                             PairCompare<StationTrain>,
+                             PairDegradedCompare<StationTrain> >;
+} // namespace sjtu
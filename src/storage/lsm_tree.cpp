@@ -0,0 +1,475 @@
+#include "storage/lsm_tree.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+#include "management/ticket.h"
+
+namespace sjtu {
+void LsmTreeStats::Print(std::ostream &os, const std::string &name) const {
+  os << name << ": lsm levels " << level_runs_.size() << ", runs";
+  for (size_t i = 0; i < level_runs_.size(); ++i) {
+    os << (i == 0 ? " " : "/") << level_runs_[i];
+  }
+  os << ", entries";
+  for (size_t i = 0; i < level_entries_.size(); ++i) {
+    os << (i == 0 ? " " : "/") << level_entries_[i];
+  }
+  os << ", memtable " << memtable_entry_cnt_ << ", tombstones " << tombstone_cnt_
+     << ", order violations " << order_violation_cnt_ << ", structure violations "
+     << structure_violation_cnt_ << '\n';
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+LSMTREE_TYPE::LsmTree(std::string name, const KeyComparator &comparator,
+                      const DegradedKeyComparator &degraded_comparator, int memtable_size)
+  : index_name_(std::move(name)),
+    comparator_(comparator),
+    degraded_comparator_(degraded_comparator),
+    memtable_size_(memtable_size) {
+  bpm_ = new BufferPoolManager(4, index_name_);
+  manifest_page_id_ = bpm_->NewPage();
+  auto guard = bpm_->ReadPage(manifest_page_id_);
+  auto manifest = guard.As<LsmManifestPage>();
+  if (manifest->initialized_ == 0) {
+    return;
+  }
+  next_run_id_ = manifest->next_run_id_;
+  for (int level = 0; level < LSM_MAX_LEVELS; ++level) {
+    for (int i = 0; i < manifest->run_cnt_[level]; ++i) {
+      levels_[level].push_back(OpenRun(manifest->run_ids_[level][i]));
+    }
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+LSMTREE_TYPE::~LsmTree() {
+  Flush();
+  SaveManifest();
+  for (int level = 0; level < LSM_MAX_LEVELS; ++level) {
+    for (int i = 0; i < levels_[level].size(); ++i) {
+      CloseRun(&levels_[level][i], false);
+    }
+  }
+  delete bpm_;
+}
+
+/*****************************************************************************
+ * POINT OPERATIONS
+ *****************************************************************************/
+INDEX_TEMPLATE_ARGUMENTS
+auto LSMTREE_TYPE::Insert(const KeyType &key, const ValueType &value) -> bool {
+  sjtu::vector<ValueType> result;
+  if (GetValue(key, &result)) {
+    return false;
+  }
+  return Upsert(key, value);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto LSMTREE_TYPE::Upsert(const KeyType &key, const ValueType &value) -> bool {
+  auto index = MemtableLowerBound(key, comparator_);
+  if (index < memtable_.size() && comparator_(memtable_[index].key_, key) == 0) {
+    memtable_[index].value_ = value;
+    memtable_[index].tombstone_ = 0;
+    return true;
+  }
+  memtable_.insert(memtable_.begin() + index, Entry{key, value, 0});
+  if (memtable_.size() >= memtable_size_) {
+    Flush();
+  }
+  return true;
+}
+
+/**
+ * A key only ever written to the memtable is dropped from it right away, any
+ * other key gets a tombstone that shadows the runs until a merge into the
+ * last level discards both.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void LSMTREE_TYPE::Remove(const KeyType &key) {
+  bool has_runs = false;
+  for (int level = 0; level < LSM_MAX_LEVELS; ++level) {
+    has_runs |= !levels_[level].empty();
+  }
+  auto index = MemtableLowerBound(key, comparator_);
+  if (index < memtable_.size() && comparator_(memtable_[index].key_, key) == 0) {
+    if (!has_runs) {
+      memtable_.erase(memtable_.begin() + index);
+      return;
+    }
+    memtable_[index].tombstone_ = 1;
+    return;
+  }
+  if (!has_runs) {
+    return;
+  }
+  Entry entry{};
+  entry.key_ = key;
+  entry.tombstone_ = 1;
+  memtable_.insert(memtable_.begin() + index, entry);
+  if (memtable_.size() >= memtable_size_) {
+    Flush();
+  }
+}
+
+/**
+ * @brief Look key up in the memtable, then in every run newest first
+ *
+ * The first version found decides; a run is only read if its fence pointers
+ * say it may hold key, and then only one of its data pages.
+ *
+ * @return true means key exists
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto LSMTREE_TYPE::GetValue(const KeyType &key, sjtu::vector<ValueType> *result) -> bool {
+  auto index = MemtableLowerBound(key, comparator_);
+  if (index < memtable_.size() && comparator_(memtable_[index].key_, key) == 0) {
+    if (memtable_[index].tombstone_ != 0) {
+      return false;
+    }
+    result->push_back(memtable_[index].value_);
+    return true;
+  }
+  for (int level = 0; level < LSM_MAX_LEVELS; ++level) {
+    for (int i = 0; i < levels_[level].size(); ++i) {
+      Cursor cursor;
+      cursor.run_ = &levels_[level][i];
+      Seek(&cursor, key, comparator_);
+      if (CursorAtEnd(cursor)) {
+        continue;
+      }
+      auto &entry = CursorEntry(cursor);
+      if (comparator_(entry.key_, key) != 0) {
+        continue;
+      }
+      if (entry.tombstone_ != 0) {
+        return false;
+      }
+      result->push_back(entry.value_);
+      return true;
+    }
+  }
+  return false;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto LSMTREE_TYPE::GetAllValue(const KeyType &key, sjtu::vector<ValueType> *result) -> bool {
+  return GetValue(key, result);
+}
+
+/*****************************************************************************
+ * FLUSH AND COMPACTION
+ *****************************************************************************/
+/**
+ * Tombstones are written out unless there is no run they could shadow. Level
+ * 0 then merges into level 1 once it holds LSM_L0_RUN_LIMIT runs, and every
+ * deeper level into the next one once it outgrows LevelCapacity.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void LSMTREE_TYPE::Flush() {
+  if (memtable_.empty()) {
+    return;
+  }
+  bool has_runs = false;
+  for (int level = 0; level < LSM_MAX_LEVELS; ++level) {
+    has_runs |= !levels_[level].empty();
+  }
+  auto run = WriteRun([&](auto &&emit) {
+    for (int i = 0; i < memtable_.size(); ++i) {
+      if (has_runs || memtable_[i].tombstone_ == 0) {
+        emit(memtable_[i]);
+      }
+    }
+  });
+  memtable_.clear();
+  if (run.entry_cnt_ == 0) {
+    CloseRun(&run, true);
+    return;
+  }
+  levels_[0].insert(levels_[0].begin(), run);
+  if (levels_[0].size() >= LSM_L0_RUN_LIMIT) {
+    MergeLevels(0, 1);
+  }
+  for (int level = 1; level + 1 < LSM_MAX_LEVELS; ++level) {
+    if (!levels_[level].empty() && levels_[level][0].entry_cnt_ > LevelCapacity(level)) {
+      MergeLevels(level, level + 1);
+    }
+  }
+  SaveManifest();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void LSMTREE_TYPE::Compact() {
+  Flush();
+  int last_level = 0;
+  int run_cnt = 0;
+  for (int level = 0; level < LSM_MAX_LEVELS; ++level) {
+    if (!levels_[level].empty()) {
+      last_level = level;
+      run_cnt += levels_[level].size();
+    }
+  }
+  if (run_cnt == 0) {
+    return;
+  }
+  MergeLevels(0, std::max(last_level, 1));
+  SaveManifest();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto LSMTREE_TYPE::LevelCapacity(int level) const -> long long {
+  long long capacity = static_cast<long long>(memtable_size_) * LSM_L0_RUN_LIMIT;
+  for (int i = 1; i < level; ++i) {
+    capacity *= LSM_LEVEL_RATIO;
+  }
+  return capacity;
+}
+
+/**
+ * @brief Rewrite levels [first_level, last_level] as one run of last_level
+ *
+ * Tombstones are dropped when no deeper level exists for them to shadow.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void LSMTREE_TYPE::MergeLevels(int first_level, int last_level) {
+  bool bottom = true;
+  for (int level = last_level + 1; level < LSM_MAX_LEVELS; ++level) {
+    bottom &= levels_[level].empty();
+  }
+  Cursor cursors[MAX_SOURCE_CNT];
+  int cursor_cnt = 0;
+  for (int level = first_level; level <= last_level; ++level) {
+    for (int i = 0; i < levels_[level].size(); ++i) {
+      auto &cursor = cursors[cursor_cnt++];
+      cursor.run_ = &levels_[level][i];
+      if (cursor.run_->fences_.size() > 1) {
+        cursor.guard_ = cursor.run_->bpm_->ReadPage(2);
+      }
+    }
+  }
+  auto run = WriteRun([&](auto &&emit) {
+    MergeCursors(cursors, cursor_cnt, [&](const Entry &entry) {
+      if (!bottom || entry.tombstone_ == 0) {
+        emit(entry);
+      }
+      return true;
+    });
+  });
+  for (int i = 0; i < cursor_cnt; ++i) {
+    cursors[i].guard_.reset();
+  }
+  for (int level = first_level; level <= last_level; ++level) {
+    for (int i = 0; i < levels_[level].size(); ++i) {
+      CloseRun(&levels_[level][i], true);
+    }
+    levels_[level].clear();
+  }
+  if (run.entry_cnt_ == 0) {
+    CloseRun(&run, true);
+    return;
+  }
+  levels_[last_level].push_back(run);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+template <typename Producer>
+auto LSMTREE_TYPE::WriteRun(Producer &&produce) -> Run {
+  Run run;
+  run.id_ = next_run_id_++;
+  std::filesystem::remove(RunFileName(run.id_));
+  run.bpm_ = new BufferPoolManager(LSM_RUN_POOL_SIZE, RunFileName(run.id_));
+  auto header_page_id = run.bpm_->NewPage();
+  std::optional<WritePageGuard> page_guard;
+  RunPage *page = nullptr;
+  KeyType last_key{};
+  produce([&](const Entry &entry) {
+    if (page == nullptr || page->size_ == RunPage::SLOT_CNT) {
+      page_guard = run.bpm_->WritePage(run.bpm_->NewPage());
+      page = page_guard->template AsMut<RunPage>();
+      page->size_ = 0;
+      run.fences_.push_back(entry.key_);
+    }
+    page->entries_[page->size_++] = entry;
+    ++run.entry_cnt_;
+    run.tombstone_cnt_ += entry.tombstone_ != 0 ? 1 : 0;
+    last_key = entry.key_;
+  });
+  page_guard.reset();
+  int data_page_cnt = run.fences_.size();
+  if (data_page_cnt > 0) {
+    run.fences_.push_back(last_key);
+  }
+  int fence_cnt = run.fences_.size();
+  int fence_page_cnt = (fence_cnt + FENCE_CNT - 1) / FENCE_CNT;
+  for (int i = 0; i < fence_page_cnt; ++i) {
+    int begin = i * FENCE_CNT;
+    int count = std::min(FENCE_CNT, fence_cnt - begin);
+    auto guard = run.bpm_->WritePage(run.bpm_->NewPage());
+    memcpy(guard.GetDataMut(), &run.fences_[begin], count * sizeof(KeyType));
+  }
+  auto header_guard = run.bpm_->WritePage(header_page_id);
+  auto header = header_guard.template AsMut<LsmRunHeaderPage>();
+  header->entry_cnt_ = run.entry_cnt_;
+  header->tombstone_cnt_ = run.tombstone_cnt_;
+  header->data_page_cnt_ = data_page_cnt;
+  header->fence_page_cnt_ = fence_page_cnt;
+  return run;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto LSMTREE_TYPE::OpenRun(int run_id) -> Run {
+  Run run;
+  run.id_ = run_id;
+  run.bpm_ = new BufferPoolManager(LSM_RUN_POOL_SIZE, RunFileName(run_id));
+  auto header_guard = run.bpm_->ReadPage(1);
+  auto header = header_guard.template As<LsmRunHeaderPage>();
+  run.entry_cnt_ = header->entry_cnt_;
+  run.tombstone_cnt_ = header->tombstone_cnt_;
+  int fence_cnt = header->data_page_cnt_ > 0 ? header->data_page_cnt_ + 1 : 0;
+  int fence_page_id = 2 + header->data_page_cnt_;
+  run.bpm_->SetNextPageId(fence_page_id + header->fence_page_cnt_ - 1);
+  for (int i = 0; i < header->fence_page_cnt_; ++i) {
+    int begin = i * FENCE_CNT;
+    int count = std::min(FENCE_CNT, fence_cnt - begin);
+    auto guard = run.bpm_->ReadPage(fence_page_id + i);
+    auto keys = reinterpret_cast<const KeyType *>(guard.GetData());
+    for (int j = 0; j < count; ++j) {
+      run.fences_.push_back(keys[j]);
+    }
+  }
+  return run;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void LSMTREE_TYPE::CloseRun(Run *run, bool drop) {
+  delete run->bpm_;
+  run->bpm_ = nullptr;
+  if (drop) {
+    std::filesystem::remove(RunFileName(run->id_));
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void LSMTREE_TYPE::SaveManifest() {
+  auto guard = bpm_->WritePage(manifest_page_id_);
+  auto manifest = guard.AsMut<LsmManifestPage>();
+  manifest->initialized_ = 1;
+  manifest->next_run_id_ = next_run_id_;
+  for (int level = 0; level < LSM_MAX_LEVELS; ++level) {
+    manifest->run_cnt_[level] = levels_[level].size();
+    for (int i = 0; i < levels_[level].size(); ++i) {
+      manifest->run_ids_[level][i] = levels_[level][i].id_;
+    }
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto LSMTREE_TYPE::RunFileName(int run_id) const -> std::string {
+  return index_name_ + "_" + std::to_string(run_id);
+}
+
+/*****************************************************************************
+ * CURSORS
+ *****************************************************************************/
+INDEX_TEMPLATE_ARGUMENTS
+auto LSMTREE_TYPE::CursorEntry(const Cursor &cursor) const -> const Entry & {
+  if (cursor.run_ == nullptr) {
+    return memtable_[cursor.index_];
+  }
+  return cursor.guard_->template As<RunPage>()->entries_[cursor.index_];
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto LSMTREE_TYPE::CursorAtEnd(const Cursor &cursor) const -> bool {
+  if (cursor.run_ == nullptr) {
+    return cursor.index_ >= memtable_.size();
+  }
+  return cursor.page_ + 1 >= static_cast<int>(cursor.run_->fences_.size());
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void LSMTREE_TYPE::Advance(Cursor *cursor) {
+  ++cursor->index_;
+  if (cursor->run_ == nullptr ||
+      cursor->index_ < cursor->guard_->template As<RunPage>()->size_) {
+    return;
+  }
+  cursor->index_ = 0;
+  ++cursor->page_;
+  if (CursorAtEnd(*cursor)) {
+    cursor->guard_.reset();
+    return;
+  }
+  cursor->guard_ = cursor->run_->bpm_->ReadPage(cursor->page_ + 2);
+}
+
+/*****************************************************************************
+ * INSPECTION
+ *****************************************************************************/
+/**
+ * @brief Walk every run page by page
+ *
+ * Read-only, meant for maintenance like BPlusTree::Stats.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto LSMTREE_TYPE::Stats() -> LsmTreeStats {
+  LsmTreeStats stats;
+  stats.memtable_entry_cnt_ = memtable_.size();
+  for (int i = 0; i < memtable_.size(); ++i) {
+    stats.tombstone_cnt_ += memtable_[i].tombstone_ != 0 ? 1 : 0;
+    if (i > 0 && comparator_(memtable_[i - 1].key_, memtable_[i].key_) >= 0) {
+      ++stats.order_violation_cnt_;
+    }
+  }
+  int level_cnt = 0;
+  for (int level = 0; level < LSM_MAX_LEVELS; ++level) {
+    if (!levels_[level].empty()) {
+      level_cnt = level + 1;
+    }
+  }
+  for (int level = 0; level < level_cnt; ++level) {
+    stats.level_runs_.push_back(levels_[level].size());
+    long long level_entries = 0;
+    for (int i = 0; i < levels_[level].size(); ++i) {
+      const auto &run = levels_[level][i];
+      int page_cnt = static_cast<int>(run.fences_.size()) - 1;
+      int entry_cnt = 0;
+      int tombstone_cnt = 0;
+      for (int p = 0; p < page_cnt; ++p) {
+        auto guard = run.bpm_->ReadPage(p + 2);
+        auto page = guard.template As<RunPage>();
+        if (page->size_ <= 0 || comparator_(page->entries_[0].key_, run.fences_[p]) != 0) {
+          ++stats.structure_violation_cnt_;
+        }
+        for (int j = 0; j < page->size_; ++j) {
+          const auto &entry = page->entries_[j];
+          tombstone_cnt += entry.tombstone_ != 0 ? 1 : 0;
+          if (j > 0 && comparator_(page->entries_[j - 1].key_, entry.key_) >= 0) {
+            ++stats.order_violation_cnt_;
+          }
+        }
+        if (p + 1 < page_cnt && page->size_ > 0 &&
+            comparator_(page->entries_[page->size_ - 1].key_, run.fences_[p + 1]) >= 0) {
+          ++stats.order_violation_cnt_;
+        }
+        if (p + 1 == page_cnt && page->size_ > 0 &&
+            comparator_(page->entries_[page->size_ - 1].key_, run.fences_[page_cnt]) != 0) {
+          ++stats.structure_violation_cnt_;
+        }
+        entry_cnt += page->size_;
+      }
+      if (entry_cnt != run.entry_cnt_ || tombstone_cnt != run.tombstone_cnt_) {
+        ++stats.structure_violation_cnt_;
+      }
+      level_entries += entry_cnt;
+      stats.tombstone_cnt_ += tombstone_cnt;
+    }
+    stats.level_entries_.push_back(level_entries);
+  }
+  return stats;
+}
+
+template class LsmTree<TrainDateOrder, PendingInfo, TDOCompare, TDODegradedCompare>;
+}  // namespace sjtu
@@ -43,7 +43,7 @@ ReadPageGuard::ReadPageGuard(ReadPageGuard &&that) noexcept {
   frame_ = std::move(that.frame_);
   replacer_ = std::move(that.replacer_);
   // bpm_latch_ = std::move(that.bpm_latch_);
-  is_valid_ = true;
+  is_valid_ = that.is_valid_;
   that.is_valid_ = false;
 }
 
@@ -72,7 +72,7 @@ auto ReadPageGuard::operator
   frame_ = std::move(that.frame_);
   replacer_ = std::move(that.replacer_);
   // bpm_latch_ = std::move(that.bpm_latch_);
-  is_valid_ = true;
+  is_valid_ = that.is_valid_;
   that.is_valid_ = false;
   return *this;
 }
@@ -149,7 +149,6 @@ WritePageGuard::WritePageGuard(page_id_t page_id,
   : page_id_(page_id), frame_(std::move(frame)),
     replacer_(std::move(replacer)) {
   is_valid_ = true;
-  frame_->is_dirty_ = true;
 }
 
 /**
@@ -174,7 +173,7 @@ WritePageGuard::WritePageGuard(WritePageGuard &&that) noexcept {
   page_id_ = that.page_id_;
   frame_ = std::move(that.frame_);
   replacer_ = std::move(that.replacer_);
-  is_valid_ = true;
+  is_valid_ = that.is_valid_;
   that.is_valid_ = false;
 }
 
@@ -202,7 +201,7 @@ auto WritePageGuard::operator=(
   page_id_ = that.page_id_;
   frame_ = std::move(that.frame_);
   replacer_ = std::move(that.replacer_);
-  is_valid_ = true;
+  is_valid_ = that.is_valid_;
   that.is_valid_ = false;
   return *this;
 }